@@ -49,8 +49,13 @@
 #else
 	#include "WProgram.h"
 #endif
+#include "ESP8266Json.h"
+#include "ESP8266Sink.h"
+#include "ESP8266Transport.h"
 
 #define ESP8266_BAUD_RATE 115200
+// responses shorter than this are not used to measure byte rate (see getByteRate())
+#define ESP8266_BYTE_RATE_MIN 128
 #define DEBUG_BAUD_RATE 9600
 
 #define ESP8266_IP_WATCHDOG_INTERVAL 15000 //time between ip (connection status) checks
@@ -64,6 +69,73 @@
 #define SERIAL_RX_BUFFER_SIZE 512
 // request buffer size
 #define REQUEST_BUFFER 5
+// request priorities (see sendHttpRequest()), higher ones are sent first
+#define PRIORITY_LOW	0
+#define PRIORITY_NORMAL	1
+#define PRIORITY_HIGH	2
+#define ESP8266_PRIORITIES 3
+
+// multiple connections mode (see setMultiplex()), max number of requests in flight at once
+#define ESP8266_MAX_LINKS 4
+// part of internal buffer kept for AT command responses in multiple connections mode,
+// rest of buffer is split equally between links for their responses
+#define ESP8266_MUX_CMD_BUFFER 128
+// time to wait for response after request was sent
+#define ESP8266_RESPONSE_TIMEOUT 30000
+// default time idle keep-alive connection stays open (see setKeepAliveTimeout())
+#define ESP8266_KEEPALIVE_TIMEOUT 10000
+// max requests sent over one connection before their responses come (see setPipelining())
+#define ESP8266_PIPELINE_DEPTH 4
+// max data length of single AT+CIPSEND
+#define ESP8266_CIPSEND_MAX 2048
+// requests are written to module in pieces of ESP8266_TX_BUFFER bytes, receive
+// ring filled by rxEvent() (see there) holds ESP8266_RX_RING, power of two up to
+// 128, both are board settings below
+// silence kept before and after "+++" which ends transparent transmission, ms
+#define ESP8266_ESCAPE_GUARD 1100
+// resolved hostnames kept (see setDnsTtl()), longer hostnames are not cached
+#define ESP8266_DNS_ENTRIES 4
+#define ESP8266_DNS_HOST 32
+// default time resolved address is used, ms
+#define ESP8266_DNS_TTL 300000
+// hosts failing to connect tracked at once (see getHostFailures())
+#define ESP8266_HOST_ENTRIES 4
+// delay before host is tried again after first failure, doubled with every next one, ms
+#define ESP8266_BACKOFF_BASE 1000
+#define ESP8266_BACKOFF_MAX 30000
+// failures in a row which open circuit breaker of host and how long it stays open, ms
+#define ESP8266_BREAKER_FAILURES 5
+#define ESP8266_BREAKER_TIMEOUT 60000
+// longest ETag or Last-Modified kept by response cache (see setCache()), longer are not cached
+#define ESP8266_CACHE_VALIDATOR 48
+// most POST bodies merged into one request (see setBatching()), queue depth limits it too
+#define ESP8266_BATCH_MAX 8
+// default most bytes of merged bodies and time first of them waits for others, ms
+#define ESP8266_BATCH_BYTES 512
+#define ESP8266_BATCH_LINGER 200
+
+// uncomment to collect request latency histograms and traces (see getLatencyCount())
+//#define ESP8266_TRACING
+
+// optional features of ESP8266Client (Features template parameter), disabled ones are
+// compiled out
+#define FEATURE_STREAMING	0x01 // setOnBodyChunk(), setJsonExtractor()
+#define FEATURE_MULTIPLEX	0x02 // setMultiplex()
+#define FEATURE_TRACING		0x04 // getLatencyCount(), setOnTrace()
+#define FEATURE_DEBUG		0x08 // debug output, needs DEBUG
+#define FEATURE_DNS			0x10 // lookup cache of setDnsTtl(), setHosts() works without it
+#ifdef ESP8266_TRACING
+	#define ESP8266_FEATURES_TRACING FEATURE_TRACING
+#else
+	#define ESP8266_FEATURES_TRACING 0
+#endif
+#ifdef DEBUG
+	#define ESP8266_FEATURES_DEBUG FEATURE_DEBUG
+#else
+	#define ESP8266_FEATURES_DEBUG 0
+#endif
+// features of default client (wifi), board ones are chosen below
+#define ESP8266_FEATURES (FEATURE_STREAMING | ESP8266_FEATURES_BOARD | ESP8266_FEATURES_TRACING | ESP8266_FEATURES_DEBUG)
 
 #define UNO			//uncomment this line when you use it with UNO board
 //#define MEGA		//uncomment this line when you use it with MEGA board
@@ -72,6 +144,23 @@
 #ifdef UNO
 
 	#define ESP8266_RST 2 // connected to RST pin on ESP8266
+	// most RAM single client may take (of 2 KB), checked when it is compiled
+	#ifndef ESP8266_RAM_BUDGET
+		#define ESP8266_RAM_BUDGET 1536
+	#endif
+	// no RAM for hostname lookup cache nor buffers of multiple links, define
+	// ESP8266_FEATURES_BOARD FEATURE_MULTIPLEX to use setMultiplex()
+	#ifndef ESP8266_FEATURES_BOARD
+		#define ESP8266_FEATURES_BOARD 0
+	#endif
+	// serial buffer of the core already holds 64 bytes, define ESP8266_RX_RING 64
+	// when rxEvent() has to cover longer busy loop()
+	#ifndef ESP8266_TX_BUFFER
+		#define ESP8266_TX_BUFFER 16
+	#endif
+	#ifndef ESP8266_RX_RING
+		#define ESP8266_RX_RING 16
+	#endif
 	#ifdef DEBUG
 		#include <SoftwareSerial.h>
 		#define DBG_RX		3
@@ -94,6 +183,18 @@
 	#endif  
  
 	#define ESP8266_RST 16 // connected to RST pin on ESP8266
+	#ifndef ESP8266_RAM_BUDGET
+		#define ESP8266_RAM_BUDGET 4096
+	#endif
+	#ifndef ESP8266_FEATURES_BOARD
+		#define ESP8266_FEATURES_BOARD (FEATURE_DNS | FEATURE_MULTIPLEX)
+	#endif
+	#ifndef ESP8266_TX_BUFFER
+		#define ESP8266_TX_BUFFER 32
+	#endif
+	#ifndef ESP8266_RX_RING
+		#define ESP8266_RX_RING 64
+	#endif
 #endif  
 	
 
@@ -119,33 +220,218 @@
 #define SERIAL_RESPONSE_FALSE	0
 #define SERIAL_RESPONSE_TRUE	1
 #define SERIAL_RESPONSE_TIMEOUT	2
+#define SERIAL_RESPONSE_PENDING	3 // internal, no keyword matched yet
+
+// response code passed to handlers when response was truncated or broken
+#define HTTP_CODE_BROKEN	999
+// response code passed to handlers when request was not sent, circuit breaker of its host is open
+#define HTTP_CODE_UNAVAILABLE	998
+// response code passed to handlers when request was not sent within its deadline
+#define HTTP_CODE_EXPIRED	997
+// response code passed to handlers when request was dropped from full queue for more important one
+#define HTTP_CODE_DROPPED	996
+// internal, stored body dropped because its request is sent again
+#define SINK_ABORTED		-1
+// response with stored body waiting for its last block to be written (see sinkPoll())
+#define SINK_FINAL_NONE		0
+#define SINK_FINAL_DONE		1 // response ended
+#define SINK_FINAL_CLOSED	2 // server closed connection
+
+// host states (see getHostFailures())
+#define HOST_READY		0
+#define HOST_BACKOFF	1 // requests wait
+#define HOST_BROKEN		2 // circuit breaker is open, requests fail
+
+// +IPD frame parser states
+#define IPD_SEARCH	0 // looking for "+IPD," in module output
+#define IPD_LENGTH	1 // reading link id and frame length, payload follows ":"
+#define IPD_TRAILER_OFF	0xFF // "\r\nOK\r\n" after frame is not expected
+
+// link (connection) states
+#define LINK_NONE		0xFF // request is not assigned to any link
+#define LINK_FREE		0
+#define LINK_CONNECTING	1 // CIPSTART/CIPSEND in progress
+#define LINK_WAITING	2 // request sent, waiting for response
+#define LINK_CLOSING	3 // response recived, waiting for CIPCLOSE
+#define LINK_IDLE		4 // open keep-alive connection, ready for next request to the same server
+
+#define REQUEST_NONE	0xFF // no request slot
+#define JSON_NONE		0xFF // no json extractor
+
+// http response parser phases
+#define HTTP_STATUS		0
+#define HTTP_HEADERS	1
+#define HTTP_BODY		2
+#define HTTP_DONE		3
+#define HTTP_LENGTH_UNKNOWN	0xFFFFFFFF
+
+// request timeline stages, each one lasts until its event (ms since previous recorded one)
+#define TRACE_QUEUE		0 // sendHttpRequest() until request is taken from queue
+#define TRACE_CONNECT	1 // CIPSTART OK, skipped on reused connection
+#define TRACE_PROMPT	2 // CIPSEND prompt
+#define TRACE_SEND		3 // SEND OK
+#define TRACE_SERVER	4 // first byte of response
+#define TRACE_RECIVE	5 // response complete
+#define TRACE_TOTAL		6 // sendHttpRequest() until response complete
+#define TRACE_STAGES	7
+#define TRACE_BUCKETS	10
+#define TRACE_NONE		0xFFFF // stage skipped
 
 #define METHOD_POST "POST"
 #define METHOD_PUT "PUT"
 #define METHOD_GET "GET"
 #define METHOD_DELETE "DELETE"
 
-#define KEYWORD_OK "\nOK"
-#define KEYWORD_SEND_OK "\nSEND OK"
-#define KEYWORD_READY "\nready"
-#define KEYWORD_ERROR "\nERROR"
-#define KEYWORD_FAIL "\nFAIL"
-#define KEYWORD_ALREAY_CONNECT "\nALREAY CONNECT"
-#define KEYWORD_CURSOR ">"
+// framing of merged POST bodies (see setBatching())
+#define BATCH_OFF	0
+#define BATCH_LINES	1 // one body per line, "a\nb\n" (newline delimited JSON)
+#define BATCH_JSON	2 // bodies are elements of JSON array, "[a,b]"
+
+// keywords looked for in module output, rows of keyword table kept in flash
+#define KEYWORD_NONE			0
+#define KEYWORD_OK				1  // "\nOK"
+#define KEYWORD_SEND_OK			2  // "\nSEND OK"
+#define KEYWORD_READY			3  // "\nready"
+#define KEYWORD_ERROR			4  // "\nERROR"
+#define KEYWORD_FAIL			5  // "\nFAIL"
+#define KEYWORD_ALREAY_CONNECT	6  // "\nALREAY CONNECT"
+#define KEYWORD_CURSOR			7  // ">"
+#define KEYWORD_IPD				8  // "+IPD,"
+#define KEYWORD_IPD_TRAILER		9  // "\r\nOK\r\n"
+#define KEYWORD_CLOSED			10 // "CLOSED"
+#define KEYWORD_UNLINK			11 // "Unlink"
+#define KEYWORD_LINK_IS_NOT		12 // "link is not"
+#define KEYWORD_CONTENT_LENGTH	13 // "content-length:"
+#define KEYWORD_CIPDOMAIN		14 // "+CIPDOMAIN:"
+#define KEYWORD_DNS_FAIL		15 // "DNS Fail"
+#define KEYWORD_STATUS_3		16 // "STATUS:3"
+#define KEYWORD_STAIP			17 // "STAIP"
+#define KEYWORD_ETAG			18 // "etag:"
+#define KEYWORD_LAST_MODIFIED	19 // "last-modified:"
+#define KEYWORDS_COUNT			20
+#define KEYWORD_LENGTH			16 // longest keyword with terminating '\0'
+#define KEYWORD_CUSTOM			0xFF // keyword given to sendATCommand(), in RAM
+
+// fixed address of host (see setHosts())
+struct ESP8266Host {
+	const char *host;
+	const char *ip; // dotted, "93.184.216.34"
+};
+
+// validator types of cached response
+#define CACHE_NONE	0
+#define CACHE_ETAG	1 // sent back as If-None-Match
+#define CACHE_DATE	2 // Last-Modified, sent back as If-Modified-Since
+#define CACHE_NO_BODY	((size_t)-1)
 
-class ESP8266 
+// cached GET response (see setCache()), sketch sets body store, the rest is kept by client
+struct ESP8266Cache {
+	char *body; // store for body delivered again on 304, NULL keeps validator only
+	size_t size;
+	uint16_t key; // hash of host, port and url, 0 is free entry
+	uint16_t check; // other hash of the same and url length, confirm key match
+	uint16_t urlLength;
+	uint8_t type;
+	char validator[ESP8266_CACHE_VALIDATOR];
+	size_t length; // of stored body, CACHE_NO_BODY when there is none
+	unsigned long used;
+};
+
+// request as given to sendHttpRequest(), moved between clients of a pool (see ESP8266Pool.h)
+struct ESP8266Request {
+	char *serverIP;
+	uint16_t port;
+	char *method;
+	char *url;
+	char *postData;
+	char *queryData;
+	boolean postFlash; // postData lives in flash
+	size_t(*producer)(char data[], size_t offset, size_t size); // body source instead of postData
+	size_t bodyLength; // of producer body
+	uint8_t id;
+	uint8_t priority;
+	unsigned long timestamp; // when request was queued
+	unsigned long deadline; // max time in queue, 0 means no limit
+};
+
+// timeline of completed request, passed to trace handler
+struct ESP8266Trace {
+	uint8_t id;
+	uint8_t link;
+	int code;
+	uint16_t stage[TRACE_STAGES]; // ms, TRACE_NONE when skipped
+};
+
+// HTTP client driving one module over SerialT port, internal buffer of RxSize bytes
+// (SERIAL_RX_BUFFER_SIZE), queue of QueueDepth requests (REQUEST_BUFFER) and optional
+// FEATURE_* features. Sizes and features are chosen per sketch, e.g.
+//
+//	ESP8266Client<HardwareSerial, 256, 3, FEATURE_STREAMING> wifi2(Serial2, 17);
+//
+// ESP8266 is client with default settings from this file.
+template <class SerialT = HardwareSerial, uint16_t RxSize = SERIAL_RX_BUFFER_SIZE, uint8_t QueueDepth = REQUEST_BUFFER,
+	uint8_t Features = ESP8266_FEATURES>
+class ESP8266Client
 {
+	enum {
+		HAS_STREAMING = (Features & FEATURE_STREAMING) != 0,
+		HAS_MULTIPLEX = (Features & FEATURE_MULTIPLEX) != 0,
+		HAS_TRACING = (Features & FEATURE_TRACING) != 0,
+		HAS_DEBUG = (Features & FEATURE_DEBUG) != 0,
+		HAS_DNS = (Features & FEATURE_DNS) != 0,
+		DNS_ENTRIES = HAS_DNS ? ESP8266_DNS_ENTRIES : 0,
+		LINKS = HAS_MULTIPLEX ? ESP8266_MAX_LINKS : 1,
+		// smallest link part of buffer, with room for terminating '\0'
+		LINK_BUFFER = HAS_MULTIPLEX ? (RxSize - ESP8266_MUX_CMD_BUFFER) / ESP8266_MAX_LINKS - 1 : RxSize - 1,
+		SINK_BLOCK = ESP8266_SINK_BLOCK < LINK_BUFFER ? ESP8266_SINK_BLOCK : LINK_BUFFER,
+		BATCH_ITEMS = ESP8266_BATCH_MAX < QueueDepth ? ESP8266_BATCH_MAX : QueueDepth,
+		// requests one link carries at once, pipelined or merged in batch
+		PIPELINE_SLOTS = ESP8266_PIPELINE_DEPTH > BATCH_ITEMS ? ESP8266_PIPELINE_DEPTH : BATCH_ITEMS
+	};
+
+	struct request : ESP8266Request {
+		uint8_t link;
+		uint16_t trace[HAS_TRACING ? TRACE_TOTAL : 1]; // ms since request was queued when stage ended
+	};
 
-	struct request {
-		char *serverIP;
-		uint8_t port;
-		char *method;
-		char *url;
-		char *postData;
-		char *queryData;
+	// link to server with its own http response parser, in single connection mode only
+	// first one is used (by streaming mode)
+	struct connection {
+		uint8_t state;
+		uint8_t pipeline[PIPELINE_SLOTS]; // slots of requests sent over this link, oldest first
+		uint8_t pipelined;
+		boolean batched; // pipelined requests are merged in one, they share response
+		boolean answered; // some of pipelined responses already came
+		char *serverIP; // server this link is connected to, kept open for next requests
+		uint16_t port;
+		boolean streaming;
+		unsigned long timestamp; // request sent or, when idle, last activity
+		unsigned long rxStarted; // micros() of first response byte
+		unsigned long rxBytes;
+		uint8_t json; // extractor parsing response body
+		uint16_t cursor; // bytes stored in link part of buffer
+		boolean overflow;
+		uint8_t httpPhase;
+		int httpCode;
+		uint8_t httpHeaderProgress;
+		boolean httpLineEmpty;
+		uint32_t httpContentLength;
+		uint32_t httpBodyRecived;
+	};
+
+	// resolved hostname, free when host is empty
+	struct dnsEntry {
+		char host[ESP8266_DNS_HOST];
+		uint8_t ip[4];
+		unsigned long expires; // millis()
 	};
 
   public:
+	// module on given serial port with RST pin wired to given pin, every instance runs its
+	// own state machine so several modules work at once (e.g. Serial1-Serial3 on MEGA,
+	// see ESP8266Pool.h). Default one (wifi) uses board settings above.
+	ESP8266Client(SerialT &serial = _wifiSerial, uint8_t resetPin = ESP8266_RST);
+
 	// init lib
 	boolean begin(void);
 
@@ -175,7 +461,19 @@ class ESP8266
 	
 
 
-	// reset the module AT+RST, after reset chip is seted as wifi client and connection mode single
+	// opt-in, after reset module and serial are switched to given baud rate (up to 921600)
+	// with AT+UART_CUR. Rate module refuses or link fails at (checked with AT, module is
+	// reset then, connect RST pin for this to work reliably) is halved down to
+	// ESP8266_BAUD_RATE. Older firmware knows only AT+CIOBAUD, which module saves in flash,
+	// it is used when save is true and begin() then first looks for module at saved rate.
+	// Call before begin().
+	void setBaudRate(unsigned long baud, boolean save = false);
+	// baud rate serial currently works with
+	unsigned long getBaudRate();
+	// bytes per second module output was recived with, measured on last longer response
+	unsigned long getByteRate();
+
+	// reset the module AT+RST, after reset chip is seted as wifi client and connection mode single (or multiple, see setMultiplex())
 	void softReset(void);
 
 	// reset the module with RST pin, blocking function!
@@ -183,18 +481,197 @@ class ESP8266
 
 	
 
-	// send http request to server
-	boolean sendHttpRequest(char serverIP[], uint8_t port, char method[], char url[], char postData[] = NULL, char queryData[] = NULL);
+	// send http request to server, requests with higher priority are sent first, request
+	// not sent within deadline (ms, 0 means no limit) ends with HTTP_CODE_EXPIRED. When queue is full, newest
+	// request with lower priority is dropped to make room (HTTP_CODE_DROPPED), if there is no
+	// such request false is returned
+	boolean sendHttpRequest(char serverIP[], uint16_t port, char method[], char url[], char postData[] = NULL, char queryData[] = NULL,
+		uint8_t priority = PRIORITY_NORMAL, unsigned long deadline = 0);
+
+	// same with post data kept in flash (F("..."))
+	boolean sendHttpRequest_P(char serverIP[], uint16_t port, char method[], char url[], const __FlashStringHelper *postData,
+		char queryData[] = NULL, uint8_t priority = PRIORITY_NORMAL, unsigned long deadline = 0);
+
+	// same with body of given length pulled from producer while it is sent, so body size is not
+	// limited by RAM. Producer fills data with size bytes of body starting at offset and returns
+	// number of bytes written (less aborts the request). Same part may be asked for again when
+	// request is sent again. Bodies longer than ESP8266_CIPSEND_MAX go in multiple AT+CIPSEND.
+	boolean sendHttpRequestFrom(char serverIP[], uint16_t port, char method[], char url[], size_t bodyLength,
+		size_t(*producer)(char data[], size_t offset, size_t size), char queryData[] = NULL,
+		uint8_t priority = PRIORITY_NORMAL, unsigned long deadline = 0);
 
 	// set function invoked on data reviced
 	void setOnDataRecived(void(*handler)(int code, char data[]));
+
+	// use multiple connections mode (AT+CIPMUX=1), call before begin(). Up to ESP8266_MAX_LINKS
+	// requests are sent at once, each over its own link, and responses are handled in order
+	// of arrival, so one slow server does not hold the others. Each link gets equal part of
+	// internal buffer for its response (streaming mode is not limited by it). Needs
+	// FEATURE_MULTIPLEX, which default client has on MEGA only, ignored without it.
+	void setMultiplex(boolean enable);
+
+	// connections are kept open after response and reused by next requests to the same
+	// server (skipping CIPSTART and CIPSTATUS), connection idle longer than given time
+	// is closed, 0 closes connection right after response. Server strings given to
+	// sendHttpRequest() must stay valid while connection is open.
+	void setKeepAliveTimeout(unsigned long timeout);
+
+	// send up to given number (max ESP8266_PIPELINE_DEPTH) of queued GET requests to
+	// the same server at once, without waiting for responses, 1 disables pipelining.
+	// Responses come in order, requests left without response when server closes
+	// connection are sent again.
+	void setPipelining(uint8_t depth);
+
+	// requests to given server are sent in transparent transmission mode (AT+CIPMODE=1):
+	// connection is opened once, module forwards everything written to serial to server
+	// and its data comes back raw, so requests cost no AT command at all. Module goes back
+	// to command mode ("+++") when request for another server comes, connection breaks
+	// or stays idle for keep-alive timeout. Single connection mode only, responses must
+	// have Content-Length. NULL disables it.
+	void setTransparent(char serverIP[], uint16_t port);
+
+	// hostnames are looked up once with AT+CIPDOMAIN (when firmware has it) and following
+	// connections go straight to cached address, so module does not resolve hostname on
+	// every AT+CIPSTART. Address is used for given time (ms, 0 disables cache) and dropped
+	// earlier when connecting to it fails. Needs FEATURE_DNS (not in UNO default client),
+	// without it module resolves hostname on every AT+CIPSTART.
+	void setDnsTtl(unsigned long ttl);
+	// fixed addresses of hosts, used without lookup and never dropped, table is not copied
+	void setHosts(const ESP8266Host hosts[], uint8_t count);
+
+	// host which cannot be connected is tried again after ESP8266_BACKOFF_BASE ms doubled
+	// with every failure in a row (up to ESP8266_BACKOFF_MAX, with random jitter), its
+	// requests wait meanwhile and requests to other hosts go first. After
+	// ESP8266_BREAKER_FAILURES failures circuit breaker of host opens for
+	// ESP8266_BREAKER_TIMEOUT ms, its requests end at once with HTTP_CODE_UNAVAILABLE
+	// without any AT traffic; then next request tries host again. Successful connection
+	// or wifi reconnect clears failures. Returns failures in a row of host.
+	uint8_t getHostFailures(const char serverIP[], uint16_t port);
+
+	// GET responses with ETag or Last-Modified are remembered in given entries (least
+	// recently used one is replaced) and next request to the same url asks server with
+	// If-None-Match or If-Modified-Since. Unchanged response comes as 304 without body,
+	// data recived handler gets code 304 and body kept in store of entry (or empty one
+	// when it has no store or body did not fit). Table is not copied, NULL disables cache.
+	//
+	//	char config[256];
+	//	ESP8266Cache cache[2] = { { config, sizeof(config) } };
+	//	wifi.setCache(cache, 2);
+	void setCache(ESP8266Cache entries[], uint8_t count);
+
+	// queued POST requests with body in RAM or flash going to the same server and url are
+	// merged into one request, bodies framed as BATCH_LINES or BATCH_JSON (BATCH_OFF
+	// disables it). Batch takes up to ESP8266_BATCH_MAX requests (and queue depth) and
+	// given number of bytes of bodies, first request waits up to linger ms for others
+	// (less when its deadline is shorter) unless batch is full. Every request of batch
+	// is finished on its own with response to batch, handlers are invoked once per
+	// request and getResponseRequestId() tells which one. Response to batch is not
+	// stored in sink.
+	//
+	//	wifi.setBatching(BATCH_JSON, 256, 500);
+	//	wifi.sendHttpRequest(server, 80, "POST", "/ingest", "{\"t\":21.5}");
+	void setBatching(uint8_t framing, size_t maxBytes = ESP8266_BATCH_BYTES, unsigned long linger = ESP8266_BATCH_LINGER);
+
+	// extra header lines ("Name: value\r\n" each) sent with every request, from RAM or
+	// flash (F("...")), string is not copied so it must stay valid
+	void setHeaders(const char headers[]);
+	void setHeaders(const __FlashStringHelper *headers);
+
+	// requests waiting in queue (not sent yet) and highest number of them seen
+	uint8_t getQueueDepth();
+	uint8_t getQueuePeak();
+	// requests accepted and not finished yet (queued or sent and waiting for response)
+	uint8_t getPendingRequests();
+	// requests dropped from queue because of deadline, to make room for more important one
+	// or because circuit breaker of their host is open
+	unsigned int getDroppedRequests();
+	// most bytes internal buffer held at once, in multiple connections mode most bytes
+	// held by single part of it (AT command response or one link response)
+	uint16_t getBufferPeak();
+
+	// moves bytes waiting in serial port to receive ring of client, so they are not lost
+	// while loop() is busy. Call it from serialEvent() (serialEvent1() on MEGA) or timer
+	// interrupt, update() calls it too. Only one interrupt may call it
+	void rxEvent();
+	// times rxEvent() found receive ring full (bytes had to stay in serial port, which
+	// drops them when it is full too) and most bytes ring held at once
+	unsigned long getRxOverruns();
+	uint8_t getRxPeak();
+
+	// static RAM taken by client (sizeof) and its main parts, one "name bytes" line each,
+	// to keep track of footprint between releases
+	void printRamReport(Print &out);
+
+	// id of last request accepted by sendHttpRequest(), ids are never 0
+	uint8_t getLastRequestId();
+	// next request accepted gets given id (not 0) and following ones count from it, pool
+	// keeps ids unique across its modules with it
+	void setNextRequestId(uint8_t id);
+
+	// request which would be sent next is taken out of queue without invoking handlers,
+	// false when nothing waits in queue. Pool moves requests of module without wifi with it
+	boolean takeRequest(ESP8266Request &r);
+	// queues request taken from other client, it keeps its id and time spent in queue,
+	// false when queue is full
+	boolean putRequest(const ESP8266Request &r);
+
+	// id of request which response is being handled, valid in data recived and body handlers
+	uint8_t getResponseRequestId();
+
+	// streaming mode, enabled by setting chunk handler. Response body is not collected
+	// in internal buffer, it is passed to chunk handler piece by piece as it arrives
+	// (status line and headers are parsed on the fly), so body can be much bigger than
+	// SERIAL_RX_BUFFER_SIZE. End handler is invoked after last chunk with http code,
+	// or HTTP_CODE_BROKEN when body was not received completely.
+	// Data recived handler is not invoked in this mode.
+	void setOnBodyChunk(void(*handler)(const char data[], size_t length));
+	void setOnBodyEnd(void(*handler)(int code));
+
+	// values of JSON response bodies are extracted as body arrives (see ESP8266Json.h), body
+	// is not collected in internal buffer and end handler gets http code as in streaming mode.
+	// Each response being recived takes one of given extractors, in multiple connections mode
+	// give one per link so responses recived at once are all parsed.
+	void setJsonExtractor(ESP8266Json extractors[], uint8_t count = 1);
+
+	// bodies not fitting internal buffer (or without Content-Length) are stored in sink
+	// block by block (see ESP8266Sink.h) when chunk handler is not set. Stored handler is
+	// invoked instead of data recived handler with http code (HTTP_CODE_BROKEN when body
+	// was not recived or stored completely), handle given by sink and body length.
+	// One body is stored at a time, others recived meanwhile go to internal buffer.
+	void setSink(ESP8266Sink *sink);
+	void setOnBodyStored(void(*handler)(int code, uint16_t handle, uint32_t length));
+
+	// http code of response being recived, valid in body chunk handler
+	int getResponseCode();
+
+	// length of body given to data recived handler, body lies in internal buffer as it
+	// came from module and may contain '\0'
+	size_t getResponseLength();
+
+	// number of completed requests which given stage (TRACE_QUEUE...TRACE_TOTAL) took time
+	// falling into given bucket, bucket ends at getLatencyLimit(bucket) ms, last one is open
+	// (FEATURE_TRACING, always 0 without it)
+	uint16_t getLatencyCount(uint8_t stage, uint8_t bucket);
+	static uint16_t getLatencyLimit(uint8_t bucket);
+	void clearLatency();
+	// set handler invoked with timeline of every completed request (broken ones too, and
+	// unsent ones failed with HTTP_CODE_UNAVAILABLE, HTTP_CODE_EXPIRED or HTTP_CODE_DROPPED,
+	// their link is LINK_NONE)
+	void setOnTrace(void(*handler)(const ESP8266Trace &trace));
 	
 
 
 protected:
+	// serial port module is connected to and its RST pin
+	SerialT &serial;
+	uint8_t resetPin;
+
 	// internal buffer for reciving and sending msg to ESP8266
-	char buffer[SERIAL_RX_BUFFER_SIZE];
+	char buffer[RxSize];
 	uint16_t bufferCursor;
+	// part of buffer used for AT command responses
+	uint16_t bufferSize;
+	uint16_t bufferPeak;
 
 	// library state
 	uint8_t state;
@@ -202,11 +679,105 @@ protected:
 	// wifi connection internal indicatior, for checking status externally use isConnected()
 	boolean connected;
 
-	request requests[REQUEST_BUFFER];
+	// request slots, free ones are on stack, queued ones in ring of their priority,
+	// sent ones are referenced by pipeline of their link
+	request requests[QueueDepth];
+	uint8_t requestsFree[QueueDepth];
+	uint8_t requestsFreeCount;
+	// ids and codes of requests ended without sending (expired, dropped, host with open
+	// circuit breaker), reported by update()
+	uint8_t requestsFailed[QueueDepth];
+	int requestsFailedCode[QueueDepth];
+	uint8_t requestsFailedCount;
+	uint8_t queue[ESP8266_PRIORITIES][QueueDepth];
+	uint8_t queueHead[ESP8266_PRIORITIES];
+	uint8_t queueLength[ESP8266_PRIORITIES];
+	uint8_t queuePeak;
+	unsigned int queueDropped;
+	uint8_t requestCounter;
+	uint8_t lastRequestId;
+	uint8_t responseRequestId;
+	int responseCode;
+	size_t responseLength;
+	// slot of request being sent (connect, CIPSEND, data)
+	uint8_t sendingRequest;
+
+	// transparent transmission
+	char *transparentIP;
+	uint16_t transparentPort;
+	boolean transparentMode; // AT+CIPMODE=1 is set
+	boolean passthrough; // module forwards serial data to server, "+++" ends it
+	boolean transparentMatches(request *r);
+	void confTransparent(boolean enable);
+	void PostConfTransparent(uint8_t serialResponseStatus);
+	void PostPassthroughStart(uint8_t serialResponseStatus);
+	void passthroughSend();
+	void dispatchPassthrough();
+	void passthroughEscape();
+	void PostEscapeGuard(uint8_t serialResponseStatus);
+	void PostEscape(uint8_t serialResponseStatus);
+	void PostEscapeProbe(uint8_t serialResponseStatus);
+
+	// multiple connections mode
+	boolean multiplexed;
+	boolean multiplexing() { return HAS_MULTIPLEX && multiplexed; }
+	connection connections[LINKS];
+	uint8_t closingLink;
+	unsigned long keepAliveTimeout;
+	uint8_t pipelineDepth;
 
 	// current ip in char array
 	char ip[16];
 
+	// hostname resolution
+	dnsEntry dnsCache[HAS_DNS ? ESP8266_DNS_ENTRIES : 1];
+	unsigned long dnsTtl;
+	const ESP8266Host *hosts;
+	uint8_t hostsCount;
+	boolean dnsUnsupported; // firmware does not know AT+CIPDOMAIN
+	const char* hostsFind(const char host[]);
+	dnsEntry* dnsFind(const char host[]);
+	boolean dnsNeeded(const char host[]);
+	boolean dnsStore(const char host[], const char address[]);
+	void dnsEvict(request *r);
+	// address (or hostname when there is none) AT+CIPSTART connects to
+	void printAddress(const char host[]);
+	void resolveHost();
+	void PostResolveHost(uint8_t serialResponseStatus);
+
+	// failing hosts, key is hash of hostname and port (0 means free entry)
+	struct hostHealth {
+		uint16_t key;
+		uint8_t failures;
+		unsigned long retryAt; // backoff or open breaker ends
+	};
+	hostHealth health[ESP8266_HOST_ENTRIES];
+	// FNV-1a of string added to key
+	uint16_t hashAdd(uint16_t key, const char s[]);
+	uint16_t hostKey(const char serverIP[], uint16_t port);
+	hostHealth* hostFind(uint16_t key);
+	// HOST_READY, HOST_BACKOFF or HOST_BROKEN
+	uint8_t hostState(request *r);
+	void hostFailed(request *r);
+	void hostSucceeded(request *r);
+	void hostsClear();
+	// takes request out of queue and ends it without sending, handlers get code from
+	// requestsReport(), false when too many wait for it already (request stays queued)
+	boolean requestFail(uint8_t slot, int code);
+	// passes code with empty body to handlers of request which got no response
+	void requestEnd(uint8_t id, int code);
+	void requestsReport();
+
+	// conditional GET, header lines of response are collected in link part of buffer
+	// while cache is set
+	ESP8266Cache *cache;
+	uint8_t cacheCount;
+	ESP8266Cache* cacheFind(request *r, boolean add);
+	// polynomial hash of string added to check, unrelated to hashAdd()
+	uint16_t cacheCheck(uint16_t check, const char s[]);
+	void cacheHeader(uint8_t id);
+	void cacheStore(uint8_t id, boolean complete);
+
 	// various timestamps
 	unsigned long currentTimestamp;
 	unsigned long serialResponseTimeout;
@@ -222,21 +793,126 @@ protected:
 	void(*wifiConnectedHandler)();
 	void(*wifiDisconnectedHandler)();
 	void(*dataRecivedHandler)(int code, char data[]);
-	void(*serialResponseHandler)(uint8_t serialResponseStatus);
+	void(*bodyChunkHandler)(const char data[], size_t length);
+	void(*bodyEndHandler)(int code);
+	ESP8266Json *jsonExtractors;
+	uint8_t jsonExtractorsCount;
+	void jsonClaim(uint8_t id);
+	// body being stored, its link (LINK_NONE when sink is free), bytes written so far and
+	// whether block waits for storage (module output is not read meanwhile), last block
+	// is waited for without blocking update() since sinkSince
+	ESP8266Sink *sink;
+	void(*bodyStoredHandler)(int code, uint16_t handle, uint32_t length);
+	uint8_t sinkLink;
+	uint16_t sinkHandle;
+	uint32_t sinkOffset;
+	boolean sinkBlocked;
+	uint8_t sinkFinal;
+	unsigned long sinkSince;
+	void sinkClaim(uint8_t id);
+	boolean sinkFlush();
+	boolean sinkPoll();
+	void sinkClose(int code);
+	// state machine step invoked with result of AT command
+	typedef void (ESP8266Client::*responseHandler)(uint8_t serialResponseStatus);
+	responseHandler serialResponseHandler;
 
 	// serial response keywords for current communication
-	char responseTrueKeywords[KEYWORDS_LIMIT][16];
-	char responseFalseKeywords[KEYWORDS_LIMIT][16];
+	uint8_t responseTrueKeywords[KEYWORDS_LIMIT];
+	uint8_t responseFalseKeywords[KEYWORDS_LIMIT];
+	static const char keywordTable[KEYWORDS_COUNT][KEYWORD_LENGTH];
+	static const uint8_t keywordFallbacks[KEYWORDS_COUNT][KEYWORD_LENGTH];
+	const char *customKeyword;
+
+	// streaming keyword matcher, number of keyword chars matched so far and
+	// latched result, advanced once per received byte so buffer is never rescanned
+	uint8_t responseTrueProgress[KEYWORDS_LIMIT];
+	uint8_t responseFalseProgress[KEYWORDS_LIMIT];
+	uint8_t responseMatch;
+
+	// module output demultiplexer, +IPD frames are parsed as bytes arrive and exactly
+	// <len> payload bytes go to http parser of the link, everything else is AT command
+	// response
+	uint8_t ipdState;
+	uint8_t ipdProgress;
+	uint8_t ipdLink;
+	uint8_t ipdTrailer;
+	uint16_t ipdLength;
+	uint16_t ipdLeft;
+	// link closed notifications, "Unlink" or "<id>,CLOSED"
+	uint8_t closedProgress;
+	uint8_t unlinkProgress;
+	boolean lineStart;
+	char lineFirst;
 
-	// find given keywords in buffer
-	boolean bufferFind(char keywords[][16]);
+	// single producer (rxEvent()) single consumer (rxPoll()) ring, producer owns head,
+	// consumer owns tail, both are free running and single byte so they are read and
+	// written atomically
+	uint8_t rxRing[ESP8266_RX_RING];
+	volatile uint8_t rxHead;
+	volatile uint8_t rxTail;
+	volatile uint8_t rxPeak;
+	volatile unsigned long rxOverruns;
+
+	void demuxReset();
+	void rxPoll();
+	void rxByte(char c);
+	void commandByte(char c);
+
+	// links and their http response parsers
+	void connectionsReset();
+	void connectionsUpdate();
+	void connectionReset(uint8_t id);
+	char* connectionBuffer(uint8_t id);
+	uint16_t connectionBufferSize();
+	void connectionByte(uint8_t id, char c);
+	void connectionFlush(uint8_t id);
+	void connectionDone(uint8_t id);
+	void connectionClosed(uint8_t id);
+	// hand oldest response over to handlers and drop its request
+	void connectionDeliver(uint8_t id, boolean recived);
+	// requests sent over link and left without response go back to queue
+	void connectionRequeue(uint8_t id);
+	// request failed before it was sent, link is closed and request goes back to queue
+	void connectionRetry();
+	// take request from queue and send it (with pipelined ones) over link
+	void connectionAssign(uint8_t id, uint8_t slot);
+	// drop oldest request sent over link
+	void connectionShift(uint8_t id);
+	// response handled, link stays open for next request or is closed
+	void connectionRelease(uint8_t id);
+	static const uint16_t traceLimits[TRACE_BUCKETS - 1];
+	uint16_t latency[HAS_TRACING ? TRACE_STAGES : 1][HAS_TRACING ? TRACE_BUCKETS : 1];
+	void(*traceHandler)(const ESP8266Trace &trace);
+	// record end of stage for request or for all requests sent over link
+	void traceMark(uint8_t slot, uint8_t stage);
+	void traceLink(uint8_t id, uint8_t stage);
+	// add timeline of oldest request sent over link (or of any request) to histograms
+	void traceFinish(uint8_t id, int code);
+	void traceRequest(uint8_t slot, uint8_t link, int code);
+	// link is connected to server of given request
+	boolean connectionMatches(uint8_t id, request *r);
+	uint8_t connectionsCount();
+
+	// reset matcher state, called when listening for new response starts
+	void keywordsReset();
+	// feed one received byte to matcher, latches SERIAL_RESPONSE_TRUE/FALSE in responseMatch
+	void keywordsMatch(char c);
+	// advance single keyword by one byte (KMP style), returns true when whole keyword matched
+	boolean keywordStep(uint8_t keyword, uint8_t &progress, char c);
+	// i-th character of keyword, read from flash
+	char keywordChar(uint8_t keyword, uint8_t i);
+	// matched chars kept when char after first i + 1 of keyword does not match
+	uint8_t keywordFallback(uint8_t keyword, uint8_t i);
+	// first occurrence of keyword in AT command response, NULL when there is none
+	char* keywordFind(uint8_t keyword);
 
 	// non blocking serial reading
-	void readResponse(unsigned long timeout, void(*handler)(uint8_t serialResponseStatus));
+	void readResponse(unsigned long timeout, responseHandler handler);
 
 	// serial keywords setters 
-	void setResponseTrueKeywords(char w1[] = "", char w2[] = "");
-	void setResponseFalseKeywords(char w1[] = "", char w2[] = "");
+	void setResponseTrueKeywords(uint8_t k1 = KEYWORD_NONE, uint8_t k2 = KEYWORD_NONE);
+	void setResponseFalseKeywords(uint8_t k1 = KEYWORD_NONE, uint8_t k2 = KEYWORD_NONE);
 
 	// attempt counter, returns true while attempt counter is lower then given max
 	boolean attempt(uint8_t max);
@@ -244,44 +920,126 @@ protected:
 
 	// sending request and reciving response procedure
 	void connectToServer();
-	static void PostConnectToServer(uint8_t serialResponseStatus);
+	void PostConnectToServer(uint8_t serialResponseStatus);
 	void checkConnection(); // not used, connection status determinated by "ALREADY CONNECTED" response from ESP8266
-	static void PostCheckConnection(uint8_t serialResponseStatus); // not used
+	void PostCheckConnection(uint8_t serialResponseStatus); // not used
 	void SendDataLength();
-	static void SendData(uint8_t serialResponseStatus);
-	static void ConfirmSend(uint8_t serialResponseStatus);
+	// request serializer, one code path both measures request and writes part of it
+	// (bytes from-to of request, when sending)
+	size_t requestWrite(request *r, boolean send, size_t from = 0, size_t to = (size_t)-1);
+	// request line and headers up to body length
+	void requestHead(request *r);
+	void requestBody(request *r);
+	size_t requestBodyLength(request *r);
+	// pipelined requests go in frames of max ESP8266_CIPSEND_MAX bytes
+	size_t sendingLength; // announced with AT+CIPSEND
+	size_t sendingOffset; // bytes sent in previous frames
+	size_t sendingTotal; // all requests of pipeline
+	// all requests of link (or their batch), measured or written as requestWrite()
+	size_t pipelineWrite(uint8_t link, boolean send = false, size_t from = 0, size_t to = (size_t)-1);
+	const char *extraHeaders;
+	boolean extraHeadersFlash;
+
+	// tx staging buffer, bytes are counted and (when sending) written in pieces
+	char txBuffer[ESP8266_TX_BUFFER];
+	uint8_t txFill;
+	size_t txCount;
+	size_t txFrom;
+	size_t txTo;
+	size_t txWritten;
+	boolean txSend;
+	boolean txFailed; // producer gave less than asked
+	void txBegin(boolean send, size_t from, size_t to);
+	void txByte(char c);
+	void txProducer(request *r);
+	// fill up announced frame which cannot be sent
+	void txPad(size_t length);
+	void txString(const char s[]);
+	void txString(const __FlashStringHelper *s);
+	void txNumber(unsigned long n);
+	void txFlush();
+	// add following queued requests to the same server to pipeline of link
+	void pipelineFill(uint8_t link);
+
+	// POST batching, requests of batch are pipeline of link written as one request
+	uint8_t batchFraming;
+	size_t batchBytes;
+	unsigned long batchLinger;
+	boolean batchable(request *r);
+	boolean batchMatches(request *r, request *other);
+	// first request of batch waits for others
+	boolean batchLingers(uint8_t slot);
+	void batchFill(uint8_t link);
+	size_t batchWrite(uint8_t link, boolean send, size_t from, size_t to);
+	void SendData(uint8_t serialResponseStatus);
+	void ConfirmSend(uint8_t serialResponseStatus);
+	// request is out, wait for its response
+	void responseWait();
 	void clearRequestData();
-	void requestsShift();
 	void clearAllRequests();
-	static void ReadMessage(uint8_t serialResponseStatus);
-	void processHttpResponse();
+	// queue new request without body
+	request* requestNew(char serverIP[], uint16_t port, char method[], char url[], char queryData[],
+		uint8_t priority, unsigned long deadline);
+	uint8_t requestAlloc();
+	void requestRelease(uint8_t slot);
+	// queued requests, O(1) except peek which drops expired ones on its way
+	void queuePush(uint8_t slot, boolean front);
+	uint8_t queuePeek();
+	void queuePop(uint8_t slot);
+	void queueDrop(uint8_t priority);
+	// deadline of queued request passed
+	boolean requestExpired(uint8_t slot);
+	request* currentRequest();
+	void dispatchRequest();
+	void ReadMessage(uint8_t serialResponseStatus);
 
 	void closeConnection(void);
-	static void PostCloseConnection(uint8_t serialResponseStatus);
+	void PostCloseConnection(uint8_t serialResponseStatus);
 
-	boolean lineStartsWith(char* base, char* str);
 	void serialFlush();
 	
 	// ip functions
 	void ipWatchdog(void);
 	void fetchIP(void);
-	static void PostFetchIP(uint8_t serialResponseStatus);
+	void PostFetchIP(uint8_t serialResponseStatus);
 	void runIPCheck();
 
 	
     // wifi connection and disconnetion internal functions
 	void connectAP(char _[], char _pwd[]);
-	static void PostConnectAP(uint8_t serialResponseStatus);
-	static void PostDisconnect(uint8_t serialResponseStatus);
+	void PostConnectAP(uint8_t serialResponseStatus);
+	void PostDisconnect(uint8_t serialResponseStatus);
+
 
+	// soft reset procedure. sets up ESP8266 as wifi client and connection mode single/multiple
+	void PostSoftReset(uint8_t serialResponseStatus);
+
+	// baud rate negotiation after reset
+	unsigned long baudTarget; // 0 keeps ESP8266_BAUD_RATE
+	unsigned long baudRate;
+	boolean baudSaved; // set with AT+CIOBAUD, survives reset
+	boolean baudSave; // AT+CIOBAUD allowed
+	uint8_t baudCommand; // 0 AT+UART_CUR, 1 AT+CIOBAUD
+	unsigned long byteRate;
+	// next lower rate tried, ESP8266_BAUD_RATE at the bottom
+	unsigned long baudLower(unsigned long baud);
+	// look for module at baudRate and lower rates, begin() with AT+CIOBAUD allowed
+	void baudFind();
+	void PostFindBaud(uint8_t serialResponseStatus);
+	void confBaud();
+	void PostConfBaud(uint8_t serialResponseStatus);
+	void PostProbeBaud(uint8_t serialResponseStatus);
 
-	// soft reset procedure. sets up ESP8266 as wifi client and connection mode single
-	static void PostSoftReset(uint8_t serialResponseStatus);
 	void confMode(byte a); // config mode STATION/ACCESPOINT/BOTH
-	static void PostConfMode(uint8_t serialResponseStatus);
+	void PostConfMode(uint8_t serialResponseStatus);
 	void confConnection(boolean mode); // config connection mode single/multiple
-	static void PostConfConnection(uint8_t serialResponseStatus);
+	void PostConfConnection(uint8_t serialResponseStatus);
 };
 
+#include "ESP8266Impl.h"
+
+typedef ESP8266Client<> ESP8266;
+// compiled once in ESP8266.cpp
+extern template class ESP8266Client<>;
 extern ESP8266 wifi;
 #endif
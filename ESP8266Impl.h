@@ -0,0 +1,3228 @@
+/*
+* Arduino ESP8266 HTTP Client library
+*
+*
+* by Igor Makowski (igor.makowski@gmail.com)
+*
+* Library for simple http communication with webserver. Library during work
+* does not block work of your program (no delay() is used!), does not use
+* memory-expensive String lib and handles most of ESP8266 errors automatic.
+* Just set handlers, connect to AP and play with it. Ideal for JSON based
+* applications.
+*
+* Library has internal static buffer. You need to set up its size according to
+* your needs (but keep in mind that only http header of response can be longer
+* than 300 characters).
+*
+* Based on work by Stan Lee(Lizq@iteadstudio.com).
+*
+*
+* The MIT License (MIT)
+*
+* Copyright (c) 2015 Igor Makowski
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*
+*/
+
+// definitions of ESP8266Client members, included by ESP8266.h
+
+#ifndef __ESP8266_IMPL_H__
+#define __ESP8266_IMPL_H__
+
+#define ESP8266_TEMPLATE template <class SerialT, uint16_t RxSize, uint8_t QueueDepth, uint8_t Features>
+#define ESP8266_CLIENT ESP8266Client<SerialT, RxSize, QueueDepth, Features>
+
+#ifdef DEBUG
+	#define DBG(message)    (HAS_DEBUG ? (void)DebugSerial.print(message) : (void)0)
+	#define DBGL(message)   (HAS_DEBUG ? (void)DebugSerial.println(message) : (void)0)
+	#define DBGW(message)   (HAS_DEBUG ? (void)DebugSerial.write(message) : (void)0)
+	#define DBGBEG()		(HAS_DEBUG ? (void)DebugSerial.begin(DEBUG_BAUD_RATE) : (void)0)
+#else
+	#define DBG(message)
+	#define DBGL(message)
+	#define DBGW(message)
+	#define DBGBEG()
+#endif
+
+#define TRACE(slot, stage)		(HAS_TRACING ? traceMark(slot, stage) : (void)0)
+#define TRACE_LINK(id, stage)	(HAS_TRACING ? traceLink(id, stage) : (void)0)
+
+// upper limits (ms) of latency histogram buckets, last bucket is open
+ESP8266_TEMPLATE
+const uint16_t ESP8266_CLIENT::traceLimits[TRACE_BUCKETS - 1] PROGMEM = { 10, 20, 50, 100, 200, 500, 1000, 2000, 5000 };
+
+// indexed by KEYWORD_* ids
+ESP8266_TEMPLATE
+const char ESP8266_CLIENT::keywordTable[KEYWORDS_COUNT][KEYWORD_LENGTH] PROGMEM = {
+	"", "\nOK", "\nSEND OK", "\nready", "\nERROR", "\nFAIL", "\nALREAY CONNECT", ">", "+IPD,", "\r\nOK\r\n",
+	"CLOSED", "Unlink", "link is not", "content-length:", "+CIPDOMAIN:", "DNS Fail", "STATUS:3", "STAIP",
+	"etag:", "last-modified:"
+};
+
+// KMP failure function of keywords above, length of longest proper prefix of keyword
+// which is also suffix of its first i + 1 chars, so mismatch costs no rescan
+ESP8266_TEMPLATE
+const uint8_t ESP8266_CLIENT::keywordFallbacks[KEYWORDS_COUNT][KEYWORD_LENGTH] PROGMEM = {
+	{ 0 }, { 0 }, { 0 }, { 0 }, { 0 }, { 0 }, { 0 }, { 0 }, { 0 }, { 0, 0, 0, 0, 1, 2 },
+	{ 0 }, { 0 }, { 0 }, { 0 }, { 0 }, { 0 }, { 0, 0, 0, 0, 0, 1, 0, 0 }, { 0 },
+	{ 0 }, { 0 }
+};
+
+
+
+ESP8266_TEMPLATE
+ESP8266_CLIENT::ESP8266Client(SerialT &_serial, uint8_t _resetPin) : serial(_serial)
+{
+	static_assert(QueueDepth > 0 && QueueDepth < REQUEST_NONE, "QueueDepth out of range");
+	static_assert(RxSize >= 128, "RxSize too small for AT command responses");
+	static_assert(!HAS_MULTIPLEX || RxSize >= ESP8266_MUX_CMD_BUFFER + ESP8266_MAX_LINKS * 32,
+		"RxSize too small for multiple connections, leave out FEATURE_MULTIPLEX");
+	static_assert((ESP8266_RX_RING & (ESP8266_RX_RING - 1)) == 0 && ESP8266_RX_RING <= 128,
+		"ESP8266_RX_RING must be power of two up to 128");
+	static_assert(ESP8266_TX_BUFFER > 0 && ESP8266_TX_BUFFER <= 255, "ESP8266_TX_BUFFER out of range");
+	static_assert(sizeof(ESP8266Client) <= ESP8266_RAM_BUDGET, "client does not fit ESP8266_RAM_BUDGET, lower RxSize or QueueDepth");
+
+	resetPin = _resetPin;
+	state = STATE_IDLE;
+	connected = false;
+	autoconnect = false;
+	ssid = NULL;
+	pwd = NULL;
+	wifiConnectedHandler = NULL;
+	wifiDisconnectedHandler = NULL;
+	dataRecivedHandler = NULL;
+	bodyChunkHandler = NULL;
+	bodyEndHandler = NULL;
+	jsonExtractors = NULL;
+	customKeyword = NULL;
+	jsonExtractorsCount = 0;
+	sink = NULL;
+	bodyStoredHandler = NULL;
+	sinkLink = LINK_NONE;
+	sinkBlocked = false;
+	sinkFinal = SINK_FINAL_NONE;
+	hostsClear();
+	cache = NULL;
+	cacheCount = 0;
+	batchFraming = BATCH_OFF;
+	batchBytes = ESP8266_BATCH_BYTES;
+	batchLinger = ESP8266_BATCH_LINGER;
+	dnsTtl = ESP8266_DNS_TTL;
+	hosts = NULL;
+	hostsCount = 0;
+	dnsUnsupported = false;
+	for (uint8_t i = 0; i < DNS_ENTRIES; i++) {
+		dnsCache[i].host[0] = '\0';
+	}
+	requestCounter = 0;
+	keepAliveTimeout = ESP8266_KEEPALIVE_TIMEOUT;
+	baudTarget = 0;
+	baudRate = ESP8266_BAUD_RATE;
+	baudSaved = false;
+	baudSave = false;
+	byteRate = 0;
+	extraHeaders = NULL;
+	extraHeadersFlash = false;
+	transparentIP = NULL;
+	transparentPort = 0;
+	transparentMode = false;
+	passthrough = false;
+	queuePeak = 0;
+	queueDropped = 0;
+	bufferPeak = 0;
+	rxHead = 0;
+	rxTail = 0;
+	rxPeak = 0;
+	rxOverruns = 0;
+	sendingRequest = REQUEST_NONE;
+	memset(connections, 0, sizeof(connections));
+	pipelineDepth = 1;
+	traceHandler = NULL;
+	clearLatency();
+	setMultiplex(false);
+	clearAllRequests();
+	connectionsReset();
+}
+
+ESP8266_TEMPLATE
+boolean ESP8266_CLIENT::begin(void)
+{
+	connected = false;
+	bufferSize = multiplexing() ? ESP8266_MUX_CMD_BUFFER : RxSize;
+	pinMode(resetPin, OUTPUT);
+	clearAllRequests();
+	hardReset();
+	// timeouts of reset responses start after hard reset, not at last update()
+	currentTimestamp = millis();
+	lastActivityTimestamp = 0;
+	DBGBEG();
+	serial.begin(ESP8266_BAUD_RATE);
+	baudRate = ESP8266_BAUD_RATE;
+	baudSaved = false;
+
+	//serial.flush();
+	//serial.setTimeout(ESP8266_SERIAL_TIMEOUT);
+	state = STATE_IDLE;
+	attemptCounter = 0;
+	if (baudSave && baudTarget != 0) {
+		// module may still run at rate saved with AT+CIOBAUD before board reset
+		baudRate = baudTarget;
+		baudFind();
+	}
+	else {
+		softReset();
+	}
+	return true;
+}
+
+ESP8266_TEMPLATE
+boolean ESP8266_CLIENT::isConnected() {
+	if (connected && strlen(ip) > 6) {
+		return true;
+	}
+	else {
+		return false;
+	}
+}
+
+
+
+ESP8266_TEMPLATE
+boolean ESP8266_CLIENT::sendHttpRequest(char _serverIP[], uint16_t _port, char _method[], char _url[], char _postData[], char _queryData[],
+	uint8_t _priority, unsigned long _deadline) {
+	request *r = requestNew(_serverIP, _port, _method, _url, _queryData, _priority, _deadline);
+	if (r == NULL) {
+		return false;
+	}
+	r->postData = _postData;
+	return true;
+}
+
+ESP8266_TEMPLATE
+boolean ESP8266_CLIENT::sendHttpRequest_P(char _serverIP[], uint16_t _port, char _method[], char _url[], const __FlashStringHelper *_postData,
+	char _queryData[], uint8_t _priority, unsigned long _deadline) {
+	request *r = requestNew(_serverIP, _port, _method, _url, _queryData, _priority, _deadline);
+	if (r == NULL) {
+		return false;
+	}
+	r->postData = (char *)reinterpret_cast<const char *>(_postData);
+	r->postFlash = true;
+	return true;
+}
+
+ESP8266_TEMPLATE
+boolean ESP8266_CLIENT::sendHttpRequestFrom(char _serverIP[], uint16_t _port, char _method[], char _url[], size_t _bodyLength,
+	size_t(*_producer)(char data[], size_t offset, size_t size), char _queryData[], uint8_t _priority, unsigned long _deadline) {
+	request *r = requestNew(_serverIP, _port, _method, _url, _queryData, _priority, _deadline);
+	if (r == NULL) {
+		return false;
+	}
+	r->producer = _producer;
+	r->bodyLength = _bodyLength;
+	return true;
+}
+
+ESP8266_TEMPLATE
+typename ESP8266_CLIENT::request* ESP8266_CLIENT::requestNew(char _serverIP[], uint16_t _port, char _method[], char _url[], char _queryData[],
+	uint8_t _priority, unsigned long _deadline) {
+	if (_priority >= ESP8266_PRIORITIES) {
+		_priority = ESP8266_PRIORITIES - 1;
+	}
+	if (requestsFreeCount == 0) {
+		// make room by dropping less important request
+		for (uint8_t p = 0; p < _priority; p++) {
+			if (queueLength[p] > 0) {
+				queueDrop(p);
+				break;
+			}
+		}
+	}
+	uint8_t slot = requestAlloc();
+	if (slot == REQUEST_NONE) {
+		DBG(F("ESP8266 tx buffer overflow \r\n"));
+		return NULL;
+	}
+
+	request &r = requests[slot];
+	r.serverIP = _serverIP;
+	r.port = _port;
+	r.method = _method;
+	r.url = _url;
+	r.postData = NULL;
+	r.postFlash = false;
+	r.producer = NULL;
+	r.bodyLength = 0;
+	r.queryData = _queryData;
+	r.link = LINK_NONE;
+	r.priority = _priority;
+	r.timestamp = currentTimestamp;
+	r.deadline = _deadline;
+	requestCounter++;
+	if (requestCounter == 0) {
+		requestCounter = 1;
+	}
+	r.id = requestCounter;
+	lastRequestId = requestCounter;
+	queuePush(slot, false);
+	return &r;
+}
+
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::clearAllRequests() {
+	for (int i = 0; i < QueueDepth; i++) {
+		requests[i].method = NULL;
+		requests[i].serverIP = NULL;
+		requests[i].postData = NULL;
+		requests[i].postFlash = false;
+		requests[i].producer = NULL;
+		requests[i].bodyLength = 0;
+		requests[i].queryData = NULL;
+		requests[i].url = NULL;
+		requests[i].port = 0;
+		requests[i].id = 0;
+		requests[i].link = LINK_NONE;
+		requestsFree[i] = QueueDepth - 1 - i;
+	}
+	requestsFreeCount = QueueDepth;
+	requestsFailedCount = 0;
+	for (uint8_t p = 0; p < ESP8266_PRIORITIES; p++) {
+		queueHead[p] = 0;
+		queueLength[p] = 0;
+	}
+	for (uint8_t l = 0; l < LINKS; l++) {
+		connections[l].pipelined = 0;
+	}
+	sendingRequest = REQUEST_NONE;
+}
+
+ESP8266_TEMPLATE
+uint8_t ESP8266_CLIENT::requestAlloc() {
+	if (requestsFreeCount == 0) {
+		return REQUEST_NONE;
+	}
+	requestsFreeCount--;
+	return requestsFree[requestsFreeCount];
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::requestRelease(uint8_t slot) {
+	requests[slot].serverIP = NULL;
+	requests[slot].link = LINK_NONE;
+	requestsFree[requestsFreeCount] = slot;
+	requestsFreeCount++;
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::queuePush(uint8_t slot, boolean front) {
+	uint8_t p = requests[slot].priority;
+	if (front) {
+		// request sent back to queue goes before newer ones
+		queueHead[p] = (queueHead[p] + QueueDepth - 1) % QueueDepth;
+		queue[p][queueHead[p]] = slot;
+	}
+	else {
+		queue[p][(queueHead[p] + queueLength[p]) % QueueDepth] = slot;
+	}
+	queueLength[p]++;
+	uint8_t depth = getQueueDepth();
+	if (depth > queuePeak) {
+		queuePeak = depth;
+	}
+}
+
+ESP8266_TEMPLATE
+uint8_t ESP8266_CLIENT::queuePeek() {
+	for (int8_t p = ESP8266_PRIORITIES - 1; p >= 0; p--) {
+		uint8_t i = 0;
+		while (i < queueLength[p]) {
+			uint8_t slot = queue[p][(queueHead[p] + i) % QueueDepth];
+			request &r = requests[slot];
+			if (requestExpired(slot)) {
+				// too late, not worth any AT traffic
+				DBG(F("ESP8266 request expired \r\n"));
+				if (!requestFail(slot, HTTP_CODE_EXPIRED)) {
+					i++;
+				}
+				continue;
+			}
+			uint8_t host = hostState(&r);
+			if (host == HOST_READY && !batchLingers(slot)) {
+				return slot;
+			}
+			if (host == HOST_BROKEN) {
+				DBG(F("ESP8266 host unavailable \r\n"));
+				if (!requestFail(slot, HTTP_CODE_UNAVAILABLE)) {
+					i++;
+				}
+				continue;
+			}
+			// host backs off or batch waits for more bodies, requests to others go first
+			i++;
+		}
+	}
+	return REQUEST_NONE;
+}
+
+ESP8266_TEMPLATE
+boolean ESP8266_CLIENT::requestExpired(uint8_t slot) {
+	request &r = requests[slot];
+	return r.deadline != 0 && (currentTimestamp - r.timestamp) > r.deadline;
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::queuePop(uint8_t slot) {
+	uint8_t p = requests[slot].priority;
+	// usually head, requests passed by (their host backs off) keep their order
+	uint8_t i = 0;
+	while (queue[p][(queueHead[p] + i) % QueueDepth] != slot) {
+		i++;
+	}
+	for (; i > 0; i--) {
+		queue[p][(queueHead[p] + i) % QueueDepth] = queue[p][(queueHead[p] + i - 1) % QueueDepth];
+	}
+	queueHead[p] = (queueHead[p] + 1) % QueueDepth;
+	queueLength[p]--;
+}
+
+ESP8266_TEMPLATE
+boolean ESP8266_CLIENT::requestFail(uint8_t slot, int code) {
+	// handler may send new request, it is called after queue walk by requestsReport()
+	if (requestsFailedCount == QueueDepth) {
+		return false;
+	}
+	queuePop(slot);
+	if (HAS_TRACING) {
+		traceMark(slot, TRACE_QUEUE);
+		traceRequest(slot, LINK_NONE, code);
+	}
+	requestsFailed[requestsFailedCount] = requests[slot].id;
+	requestsFailedCode[requestsFailedCount] = code;
+	requestsFailedCount++;
+	requestRelease(slot);
+	queueDropped++;
+	return true;
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::requestEnd(uint8_t id, int code) {
+	char none[1] = { '\0' };
+	responseRequestId = id;
+	responseCode = code;
+	responseLength = 0;
+	if (HAS_STREAMING && (bodyChunkHandler != NULL || jsonExtractors != NULL)) {
+		if (bodyEndHandler != NULL) {
+			bodyEndHandler(code);
+		}
+	}
+	else if (dataRecivedHandler != NULL) {
+		dataRecivedHandler(code, none);
+	}
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::requestsReport() {
+	// requests ended on queue walk, handlers may send new requests here
+	for (uint8_t i = 0; i < requestsFailedCount; i++) {
+		requestEnd(requestsFailed[i], requestsFailedCode[i]);
+	}
+	requestsFailedCount = 0;
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::queueDrop(uint8_t priority) {
+	// newest request of given priority, its handler is called by next update()
+	if (requestFail(queue[priority][(queueHead[priority] + queueLength[priority] - 1) % QueueDepth], HTTP_CODE_DROPPED)) {
+		DBG(F("ESP8266 request dropped \r\n"));
+	}
+}
+
+ESP8266_TEMPLATE
+uint8_t ESP8266_CLIENT::getQueueDepth() {
+	uint8_t depth = 0;
+	for (uint8_t p = 0; p < ESP8266_PRIORITIES; p++) {
+		depth += queueLength[p];
+	}
+	return depth;
+}
+
+ESP8266_TEMPLATE
+uint8_t ESP8266_CLIENT::getPendingRequests() {
+	return QueueDepth - requestsFreeCount;
+}
+
+ESP8266_TEMPLATE
+uint8_t ESP8266_CLIENT::getQueuePeak() {
+	return queuePeak;
+}
+
+ESP8266_TEMPLATE
+unsigned int ESP8266_CLIENT::getDroppedRequests() {
+	return queueDropped;
+}
+
+ESP8266_TEMPLATE
+uint16_t ESP8266_CLIENT::getBufferPeak() {
+	return bufferPeak;
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::printRamReport(Print &out) {
+	size_t parts[] = {
+		sizeof(buffer),
+		sizeof(requests) + sizeof(requestsFree) + sizeof(requestsFailed) + sizeof(requestsFailedCode) + sizeof(queue) + sizeof(queueHead) + sizeof(queueLength),
+		sizeof(connections),
+		sizeof(dnsCache),
+		sizeof(responseTrueKeywords) + sizeof(responseFalseKeywords) + sizeof(customKeyword)
+			+ sizeof(responseTrueProgress) + sizeof(responseFalseProgress),
+		sizeof(txBuffer),
+		sizeof(rxRing),
+		sizeof(latency)
+	};
+	// keyword table and trace limits are in flash, they are not counted
+	static const char names[][12] PROGMEM = { "buffer", "requests", "connections", "dns", "matcher", "tx", "ring", "tracing" };
+	size_t rest = sizeof(*this);
+	for (uint8_t i = 0; i < sizeof(parts) / sizeof(parts[0]); i++) {
+		out.print((const __FlashStringHelper *)names[i]);
+		out.print(' ');
+		out.println((unsigned long)parts[i]);
+		rest -= parts[i];
+	}
+	out.print(F("other "));
+	out.println((unsigned long)rest);
+	out.print(F("total "));
+	out.println((unsigned long)sizeof(*this));
+}
+
+ESP8266_TEMPLATE
+typename ESP8266_CLIENT::request* ESP8266_CLIENT::currentRequest() {
+	return sendingRequest != REQUEST_NONE ? &requests[sendingRequest] : NULL;
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::dispatchRequest() {
+	uint8_t links = connectionsCount();
+	uint8_t l;
+
+	if (passthrough) {
+		dispatchPassthrough();
+		return;
+	}
+
+	// sockets to be closed go first, idle ones are closed after keep-alive timeout
+	for (l = 0; l < links; l++) {
+		if (connections[l].state == LINK_IDLE
+			&& ((currentTimestamp - connections[l].timestamp) > keepAliveTimeout || currentTimestamp < connections[l].timestamp)) {
+			connections[l].state = LINK_CLOSING;
+		}
+		if (connections[l].state == LINK_CLOSING) {
+			closingLink = l;
+			closeConnection();
+			return;
+		}
+	}
+
+	// most important request, expired ones are dropped before they cost anything
+	uint8_t slot = queuePeek();
+	if (slot == REQUEST_NONE) {
+		return;
+	}
+	request *r = &requests[slot];
+
+	// transparent mode is switched with connection closed
+	if (transparentMatches(r) != transparentMode) {
+		if (connections[0].state == LINK_IDLE) {
+			connections[0].state = LINK_CLOSING;
+		}
+		else {
+			confTransparent(!transparentMode);
+		}
+		return;
+	}
+
+	// reuse open connection to the same server
+	for (l = 0; l < links; l++) {
+		if (connections[l].state == LINK_IDLE && connectionMatches(l, r)) {
+			connectionAssign(l, slot);
+			SendDataLength();
+			return;
+		}
+	}
+
+	for (l = 0; l < links; l++) {
+		if (connections[l].state == LINK_FREE) {
+			connections[l].serverIP = r->serverIP;
+			connections[l].port = r->port;
+			connectionAssign(l, slot);
+			if (dnsNeeded(r->serverIP)) {
+				resolveHost();
+			}
+			else {
+				connectToServer();
+			}
+			return;
+		}
+	}
+
+	// no free link, make room by closing connection kept open for another server
+	for (l = 0; l < links; l++) {
+		if (connections[l].state == LINK_IDLE) {
+			connections[l].state = LINK_CLOSING;
+			return;
+		}
+	}
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::pipelineFill(uint8_t link) {
+	connection &c = connections[link];
+	request *r = &requests[c.pipeline[0]];
+	if (batchable(r)) {
+		batchFill(link);
+		return;
+	}
+	// only requests without body are safe to send again when connection breaks
+	if (strcmp_P(r->method, PSTR(METHOD_GET)) != 0) {
+		return;
+	}
+	size_t length = requestWrite(r, false);
+	while (c.pipelined < pipelineDepth) {
+		// pipeline keeps order of queue, it ends on first request it cannot take
+		uint8_t slot = queuePeek();
+		if (slot == REQUEST_NONE) {
+			break;
+		}
+		r = &requests[slot];
+		if (strcmp_P(r->method, PSTR(METHOD_GET)) != 0 || !connectionMatches(link, r)) {
+			break;
+		}
+		length += requestWrite(r, false);
+		if (length > ESP8266_CIPSEND_MAX) {
+			break;
+		}
+		queuePop(slot);
+		r->link = link;
+		c.pipeline[c.pipelined] = slot;
+		c.pipelined++;
+	}
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::setBatching(uint8_t framing, size_t maxBytes, unsigned long linger) {
+	batchFraming = framing;
+	batchBytes = maxBytes;
+	batchLinger = linger;
+}
+
+ESP8266_TEMPLATE
+boolean ESP8266_CLIENT::batchable(request *r) {
+	return batchFraming != BATCH_OFF && r->postData != NULL && r->producer == NULL
+		&& strcmp_P(r->method, PSTR(METHOD_POST)) == 0;
+}
+
+ESP8266_TEMPLATE
+boolean ESP8266_CLIENT::batchMatches(request *r, request *other) {
+	return batchable(other) && r->port == other->port
+		&& (r->serverIP == other->serverIP || strcmp(r->serverIP, other->serverIP) == 0)
+		&& strcmp(r->url, other->url) == 0
+		&& (r->queryData == other->queryData
+			|| (r->queryData != NULL && other->queryData != NULL && strcmp(r->queryData, other->queryData) == 0));
+}
+
+ESP8266_TEMPLATE
+boolean ESP8266_CLIENT::batchLingers(uint8_t slot) {
+	request *r = &requests[slot];
+	if (!batchable(r) || requestsFreeCount == 0) {
+		return false;
+	}
+	unsigned long linger = batchLinger;
+	if (r->deadline != 0 && r->deadline < linger) {
+		linger = r->deadline;
+	}
+	if ((currentTimestamp - r->timestamp) >= linger) {
+		return false;
+	}
+	// full batch goes at once
+	uint8_t items = 0;
+	size_t bytes = 0;
+	for (uint8_t p = 0; p < ESP8266_PRIORITIES; p++) {
+		for (uint8_t i = 0; i < queueLength[p]; i++) {
+			request *other = &requests[queue[p][(queueHead[p] + i) % QueueDepth]];
+			if (batchMatches(r, other)) {
+				items++;
+				bytes += requestBodyLength(other);
+			}
+		}
+	}
+	return items < BATCH_ITEMS && bytes < batchBytes;
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::batchFill(uint8_t link) {
+	connection &c = connections[link];
+	request *r = &requests[c.pipeline[0]];
+	size_t bytes = requestBodyLength(r);
+	c.batched = true;
+	// more important requests first, each priority in order of queue
+	for (int8_t p = ESP8266_PRIORITIES - 1; p >= 0; p--) {
+		uint8_t i = 0;
+		while (i < queueLength[p] && c.pipelined < BATCH_ITEMS) {
+			uint8_t slot = queue[p][(queueHead[p] + i) % QueueDepth];
+			request *other = &requests[slot];
+			if (batchMatches(r, other) && requestExpired(slot)) {
+				DBG(F("ESP8266 request expired \r\n"));
+				if (!requestFail(slot, HTTP_CODE_EXPIRED)) {
+					i++;
+				}
+				continue;
+			}
+			if (!batchMatches(r, other) || bytes + requestBodyLength(other) > batchBytes) {
+				i++;
+				continue;
+			}
+			bytes += requestBodyLength(other);
+			queuePop(slot);
+			other->link = link;
+			c.pipeline[c.pipelined] = slot;
+			c.pipelined++;
+		}
+	}
+}
+
+ESP8266_TEMPLATE
+size_t ESP8266_CLIENT::batchWrite(uint8_t link, boolean send, size_t from, size_t to) {
+	connection &c = connections[link];
+	// framing takes byte per body, JSON array one more
+	size_t length = batchFraming == BATCH_JSON ? c.pipelined + 1 : c.pipelined;
+	for (uint8_t p = 0; p < c.pipelined; p++) {
+		length += requestBodyLength(&requests[c.pipeline[p]]);
+	}
+	txBegin(send, from, to);
+	requestHead(&requests[c.pipeline[0]]);
+	txString(F("Content-Length: "));
+	txNumber(length);
+	txString(F("\r\n\r\n"));
+	if (batchFraming == BATCH_JSON) {
+		txByte('[');
+	}
+	for (uint8_t p = 0; p < c.pipelined; p++) {
+		if (batchFraming == BATCH_JSON && p > 0) {
+			txByte(',');
+		}
+		requestBody(&requests[c.pipeline[p]]);
+		if (batchFraming == BATCH_LINES) {
+			txByte('\n');
+		}
+	}
+	if (batchFraming == BATCH_JSON) {
+		txByte(']');
+	}
+	txFlush();
+	return txCount;
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::setKeepAliveTimeout(unsigned long timeout) {
+	keepAliveTimeout = timeout;
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::setPipelining(uint8_t depth) {
+	pipelineDepth = constrain(depth, 1, ESP8266_PIPELINE_DEPTH);
+}
+
+ESP8266_TEMPLATE
+uint8_t ESP8266_CLIENT::getLastRequestId() {
+	return lastRequestId;
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::setNextRequestId(uint8_t id) {
+	requestCounter = id - 1;
+}
+
+ESP8266_TEMPLATE
+boolean ESP8266_CLIENT::takeRequest(ESP8266Request &r) {
+	for (int8_t p = ESP8266_PRIORITIES - 1; p >= 0; p--) {
+		if (queueLength[p] > 0) {
+			uint8_t slot = queue[p][queueHead[p]];
+			r = requests[slot];
+			queuePop(slot);
+			requestRelease(slot);
+			return true;
+		}
+	}
+	return false;
+}
+
+ESP8266_TEMPLATE
+boolean ESP8266_CLIENT::putRequest(const ESP8266Request &r) {
+	uint8_t slot = requestAlloc();
+	if (slot == REQUEST_NONE) {
+		return false;
+	}
+	static_cast<ESP8266Request &>(requests[slot]) = r;
+	requests[slot].link = LINK_NONE;
+	queuePush(slot, false);
+	return true;
+}
+
+ESP8266_TEMPLATE
+uint8_t ESP8266_CLIENT::getResponseRequestId() {
+	return responseRequestId;
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::setMultiplex(boolean enable) {
+	multiplexed = HAS_MULTIPLEX && enable;
+	bufferSize = multiplexing() ? ESP8266_MUX_CMD_BUFFER : RxSize;
+}
+
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::hardReset(void)
+{
+	connected = false;
+	ip[0] = '\0';
+	digitalWrite(resetPin, LOW);
+	delay(ESP8266_HARD_RESET_DURACTION);
+	digitalWrite(resetPin, HIGH);
+	delay(ESP8266_HARD_RESET_DURACTION);
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::softReset(void)
+{
+	connected = false;
+	ip[0] = '\0';
+	state = STATE_RESETING;
+	connectionsReset();
+	// module comes back in normal transmission mode
+	transparentMode = false;
+	passthrough = false;
+	serial.println(F("AT+RST"));
+	if (baudRate != ESP8266_BAUD_RATE && !baudSaved) {
+		// module comes back with default baud rate
+		serial.flush();
+		serial.begin(ESP8266_BAUD_RATE);
+		baudRate = ESP8266_BAUD_RATE;
+	}
+
+	setResponseTrueKeywords(KEYWORD_READY);
+	setResponseFalseKeywords();
+	readResponse(15000, &ESP8266Client::PostSoftReset);
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::PostSoftReset(uint8_t serialResponseStatus)
+{
+	if (serialResponseStatus == SERIAL_RESPONSE_TRUE) {
+		state = STATE_RESETING;
+		if (baudTarget != 0 && baudTarget != baudRate) {
+			baudCommand = 0;
+			confBaud();
+		}
+		else {
+			confMode(STA);
+		}
+	}
+	else {
+		if (attempt(3)) {
+			softReset();
+		}
+		else {
+			DBG(buffer);
+			DBG(F("\r\nESP8266 is not responding! \r\n"));
+			state = STATE_ERROR;
+		}
+	}
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::baudFind()
+{
+	serial.flush();
+	serial.begin(baudRate);
+	serial.println(F("AT"));
+
+	// AT is lost while module boots after hard reset, it says ready then
+	setResponseTrueKeywords(KEYWORD_OK, KEYWORD_READY);
+	setResponseFalseKeywords();
+	readResponse(3000, &ESP8266Client::PostFindBaud);
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::PostFindBaud(uint8_t serialResponseStatus)
+{
+	state = STATE_RESETING;
+	if (serialResponseStatus == SERIAL_RESPONSE_TRUE) {
+		// module comes back from reset at the same rate
+		baudSaved = baudRate != ESP8266_BAUD_RATE;
+		softReset();
+	}
+	else {
+		baudRate = baudLower(baudRate);
+		if (baudRate != ESP8266_BAUD_RATE) {
+			baudFind();
+		}
+		else {
+			serial.flush();
+			serial.begin(ESP8266_BAUD_RATE);
+			softReset();
+		}
+	}
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::confBaud()
+{
+	// newer firmware knows AT+UART_CUR (not saved), v0.20 only AT+CIOBAUD (saved, opt-in)
+	if (baudCommand == 0) {
+		serial.print(F("AT+UART_CUR="));
+		serial.print(baudTarget);
+		serial.println(F(",8,1,0,0"));
+	}
+	else {
+		serial.print(F("AT+CIOBAUD="));
+		serial.println(baudTarget);
+	}
+
+	setResponseTrueKeywords(KEYWORD_OK);
+	setResponseFalseKeywords(KEYWORD_ERROR);
+	readResponse(2000, &ESP8266Client::PostConfBaud);
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::PostConfBaud(uint8_t serialResponseStatus)
+{
+	state = STATE_RESETING;
+	if (serialResponseStatus == SERIAL_RESPONSE_TRUE) {
+		// module has switched right after OK
+		serial.flush();
+		serial.begin(baudTarget);
+		baudRate = baudTarget;
+		baudSaved = baudCommand == 1;
+		serial.println(F("AT"));
+
+		setResponseTrueKeywords(KEYWORD_OK);
+		setResponseFalseKeywords();
+		readResponse(1000, &ESP8266Client::PostProbeBaud);
+	}
+	else if (baudCommand == 0 && baudSave) {
+		baudCommand = 1;
+		confBaud();
+	}
+	else {
+		// rate refused or command unknown, try next lower one
+		baudTarget = baudLower(baudTarget);
+		baudCommand = 0;
+		if (baudTarget != ESP8266_BAUD_RATE && baudTarget != baudRate) {
+			confBaud();
+		}
+		else {
+			DBG(F("ESP8266 baud rate not supported \r\n"));
+			baudTarget = 0;
+			confMode(STA);
+		}
+	}
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::PostProbeBaud(uint8_t serialResponseStatus)
+{
+	state = STATE_RESETING;
+	if (serialResponseStatus == SERIAL_RESPONSE_TRUE) {
+		DBG(F("ESP8266 baud rate: "));
+		DBG(baudRate);
+		DBG(F("\r\n"));
+		confMode(STA);
+	}
+	else {
+		// link does not work at this speed, try to reset module (AT+UART_CUR does not
+		// survive it) and start again with default baud rate, next reset tries lower one
+		DBG(F("ESP8266 baud rate check failed, falling back \r\n"));
+		serial.println(F("AT+RST"));
+		serial.flush();
+		baudTarget = baudLower(baudRate);
+		if (baudTarget == ESP8266_BAUD_RATE) {
+			baudTarget = 0;
+		}
+		baudRate = ESP8266_BAUD_RATE;
+		baudSaved = false;
+		hardReset();
+		serial.begin(ESP8266_BAUD_RATE);
+		softReset();
+	}
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::setBaudRate(unsigned long baud, boolean save) {
+	baudTarget = baud == ESP8266_BAUD_RATE ? 0 : baud;
+	baudSave = save;
+}
+
+ESP8266_TEMPLATE
+unsigned long ESP8266_CLIENT::baudLower(unsigned long baud) {
+	// 921600, 460800, 230400
+	return baud / 2 > ESP8266_BAUD_RATE ? baud / 2 : ESP8266_BAUD_RATE;
+}
+
+ESP8266_TEMPLATE
+unsigned long ESP8266_CLIENT::getBaudRate() {
+	return baudRate;
+}
+
+ESP8266_TEMPLATE
+unsigned long ESP8266_CLIENT::getByteRate() {
+	return byteRate;
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::confMode(byte a)
+{
+	serial.print(F("AT+CWMODE="));
+	serial.println(a);
+
+	setResponseTrueKeywords(KEYWORD_OK);
+	setResponseFalseKeywords(KEYWORD_ERROR);
+	readResponse(2000, &ESP8266Client::PostConfMode);
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::PostConfMode(uint8_t serialResponseStatus)
+{
+	if (serialResponseStatus == SERIAL_RESPONSE_TRUE) {
+		//DBG("ESP8266 wifi mode setted \r\n");
+		state = STATE_RESETING;
+		confConnection(multiplexing());
+	}
+	else {
+		DBG(F("ESP8266 wifi mode error! \r\n"));
+		state = STATE_ERROR;
+	}
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::confConnection(boolean mode)
+{
+	serial.print(F("AT+CIPMUX="));
+	serial.println(mode);
+
+	setResponseTrueKeywords(KEYWORD_OK);
+	setResponseFalseKeywords();
+	readResponse(3000, &ESP8266Client::PostConfConnection);
+
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::PostConfConnection(uint8_t serialResponseStatus) {
+	if (serialResponseStatus == SERIAL_RESPONSE_TRUE) {
+		DBG(F("ESP8266 is ready \r\n"));
+		state = STATE_IDLE;
+	}
+	else {
+		state = STATE_ERROR;
+		DBG(buffer);
+		DBG(F("\r\nESP8266 connection mode ERROR  \r\n"));
+	}
+}
+
+
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::connect(char _ssid[], char _pwd[])
+{
+	ssid = _ssid;
+	pwd = _pwd;
+	autoconnect = true;
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::connectAP(char _ssid[], char _pwd[])
+{
+	serial.print(F("AT+CWJAP=\""));
+	serial.print(_ssid);
+	serial.print(F("\",\""));
+	serial.print(_pwd);
+	serial.println(F("\""));
+
+	setResponseTrueKeywords(KEYWORD_OK);
+	setResponseFalseKeywords(KEYWORD_FAIL);
+	readResponse(10000, &ESP8266Client::PostConnectAP);
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::PostConnectAP(uint8_t serialResponseStatus) {
+	if (serialResponseStatus == SERIAL_RESPONSE_TRUE) {
+		state = STATE_CONNECTED;
+		connected = true;
+		DBG(F("ESP8266 connected to wifi \r\n"));
+		runIPCheck();
+		ipWatchdog();
+	}
+	else if (serialResponseStatus == SERIAL_RESPONSE_FALSE) {
+		state = STATE_ERROR;
+		DBG(buffer);
+		DBG(F("ESP8266 wrong password \r\n"));
+	}
+	else {
+		DBG(buffer);
+		DBG(F("\r\n"));
+		connected = false;
+		state = STATE_IDLE;
+		DBG(F("ESP8266 connection timeout \r\n"));
+	}
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::setOnWifiConnected(void(*handler)()) {
+	wifiConnectedHandler = handler;
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::disconnect()
+{
+	autoconnect = false;
+	serial.println(F("AT+CWQAP"));
+	setResponseTrueKeywords(KEYWORD_OK);
+	setResponseFalseKeywords();
+	readResponse(3000, &ESP8266Client::PostDisconnect);
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::PostDisconnect(uint8_t serialResponseStatus) {
+	if (serialResponseStatus == SERIAL_RESPONSE_TRUE) {
+		state = STATE_IDLE;
+		if (connected && wifiDisconnectedHandler != NULL) {
+			wifiDisconnectedHandler();
+		}
+		ip[0] = '\0';
+		connected = false;
+	}
+	else {
+		DBG(F("ESP8266 disconnecting error\r\n"));
+	}
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::setOnWifiDisconnected(void(*handler)()) {
+	wifiDisconnectedHandler = handler;
+}
+
+
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::connectToServer() {
+	state = STATE_SENDING_DATA;
+	request *r = currentRequest();
+	serial.print(F("AT+CIPSTART="));
+	if (multiplexing()) {
+		serial.print(r->link);
+		serial.print(F(","));
+	}
+	serial.print(F("\"TCP\",\""));
+	printAddress(r->serverIP);
+	serial.print(F("\","));
+	serial.println(r->port);
+
+	setResponseTrueKeywords(KEYWORD_OK, KEYWORD_ALREAY_CONNECT);
+	setResponseFalseKeywords(KEYWORD_ERROR);
+	readResponse(5000, &ESP8266Client::PostConnectToServer);
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::PostConnectToServer(uint8_t serialResponseStatus) {
+	if (serialResponseStatus == SERIAL_RESPONSE_TRUE) {
+		state = STATE_SENDING_DATA;
+		hostSucceeded(currentRequest());
+		TRACE_LINK(currentRequest()->link, TRACE_CONNECT);
+		//DBG(F("ESP8266 server connected \r\n"));
+		if (multiplexing()) {
+			// STATUS:3 says nothing about particular link, CIPSTART response is enough
+			SendDataLength();
+		}
+		else {
+			checkConnection();
+		}
+	}
+	else if (serialResponseStatus == SERIAL_RESPONSE_FALSE) {
+			attemptCounter = 0;
+			state = STATE_CONNECTED;
+			dnsEvict(currentRequest());
+			hostFailed(currentRequest());
+			connectionRetry();
+			DBG(F("ESP8266 server connection error, checking wifi \r\n"));
+			runIPCheck();
+
+	}
+	else {
+		attemptCounter = 0;
+		state = STATE_CONNECTED;
+		dnsEvict(currentRequest());
+		hostFailed(currentRequest());
+		connectionRetry();
+		DBG(buffer);
+		DBG(F("\r\n"));
+		DBG(F("ESP8266 server connection timeout \r\n"));
+		runIPCheck();
+	}
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::resolveHost() {
+	state = STATE_SENDING_DATA;
+	serial.print(F("AT+CIPDOMAIN=\""));
+	serial.print(currentRequest()->serverIP);
+	serial.println(F("\""));
+
+	setResponseTrueKeywords(KEYWORD_OK);
+	setResponseFalseKeywords(KEYWORD_ERROR);
+	readResponse(10000, &ESP8266Client::PostResolveHost);
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::PostResolveHost(uint8_t serialResponseStatus) {
+	request *r = currentRequest();
+	char *address = keywordFind(KEYWORD_CIPDOMAIN);
+	if (serialResponseStatus == SERIAL_RESPONSE_TRUE && address != NULL) {
+		dnsStore(r->serverIP, address + strlen_P(keywordTable[KEYWORD_CIPDOMAIN]));
+		connectToServer();
+	}
+	else if (serialResponseStatus == SERIAL_RESPONSE_FALSE && keywordFind(KEYWORD_DNS_FAIL) != NULL) {
+		DBG(F("ESP8266 DNS fail \r\n"));
+		state = STATE_CONNECTED;
+		hostFailed(r);
+		connectionRetry();
+	}
+	else {
+		if (serialResponseStatus == SERIAL_RESPONSE_FALSE) {
+			// older firmware, module resolves hostname on every connect
+			dnsUnsupported = true;
+		}
+		connectToServer();
+	}
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::checkConnection() {
+	state = STATE_SENDING_DATA;
+	serial.println(F("AT+CIPSTATUS"));
+
+	setResponseTrueKeywords(KEYWORD_OK);
+	setResponseFalseKeywords(KEYWORD_ERROR);
+	readResponse(15000, &ESP8266Client::PostCheckConnection);
+
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::PostCheckConnection(uint8_t serialResponseStatus) {
+	if (serialResponseStatus == SERIAL_RESPONSE_TRUE  && keywordFind(KEYWORD_STATUS_3) != NULL) {
+		state = STATE_SENDING_DATA;
+		//DBG("ESP8266 server connection check OK \r\n");
+		SendDataLength();
+	}
+	else if(attempt(3)) {
+		connectToServer();
+	}
+	else  {
+		state = STATE_CONNECTED;
+		hostFailed(currentRequest());
+		connectionRetry();
+		DBG(buffer);
+		DBG(F("\r\nESP8266 server connection check FALSE or TIMEOUT \r\n"));
+	}
+}
+
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::SendDataLength()
+{
+	state = STATE_SENDING_DATA;
+	request *r = currentRequest();
+
+	if (transparentMode) {
+		// no length, everything after prompt goes to server until "+++"
+		serial.println(F("AT+CIPSEND"));
+		setResponseTrueKeywords(KEYWORD_CURSOR);
+		setResponseFalseKeywords(KEYWORD_LINK_IS_NOT, KEYWORD_ERROR);
+		readResponse(5000, &ESP8266Client::PostPassthroughStart);
+		return;
+	}
+
+	// pipelined requests go together, split in frames module can take
+	if (sendingOffset == 0) {
+		sendingTotal = pipelineWrite(r->link);
+	}
+	sendingLength = sendingTotal - sendingOffset;
+	if (sendingLength > ESP8266_CIPSEND_MAX) {
+		sendingLength = ESP8266_CIPSEND_MAX;
+	}
+	serial.print(F("AT+CIPSEND="));
+	if (multiplexing()) {
+		serial.print(r->link);
+		serial.print(F(","));
+	}
+	serial.println(sendingLength);
+
+	setResponseTrueKeywords(KEYWORD_CURSOR);
+	// reused connection might have been closed by server in the meantime
+	setResponseFalseKeywords(KEYWORD_LINK_IS_NOT, KEYWORD_ERROR);
+	readResponse(5000, &ESP8266Client::SendData);
+}
+
+ESP8266_TEMPLATE
+size_t ESP8266_CLIENT::pipelineWrite(uint8_t link, boolean send, size_t from, size_t to) {
+	connection &c = connections[link];
+	if (c.batched) {
+		return batchWrite(link, send, from, to);
+	}
+	// frame is window of pipeline, each request writes its part of it
+	size_t base = 0;
+	for (uint8_t p = 0; p < c.pipelined && base < to; p++) {
+		base += requestWrite(&requests[c.pipeline[p]], send, from > base ? from - base : 0, to - base);
+	}
+	return base;
+}
+
+ESP8266_TEMPLATE
+size_t ESP8266_CLIENT::requestWrite(request *r, boolean send, size_t from, size_t to) {
+	txBegin(send, from, to);
+	requestHead(r);
+	if (r->producer != NULL) {
+		txString(F("Content-Length: "));
+		txNumber(r->bodyLength);
+		txString(F("\r\n\r\n"));
+		txProducer(r);
+	}
+	else if (r->postData != NULL) {
+		txString(F("Content-Length: "));
+		txNumber(requestBodyLength(r));
+		txString(F("\r\n\r\n"));
+		requestBody(r);
+	}
+	else {
+		txString(F("\r\n"));
+	}
+	txFlush();
+	return txCount;
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::requestHead(request *r) {
+	txString(r->method);
+	txByte(' ');
+	txString(r->url);
+	if (r->queryData != NULL) {
+		txString(F("?q="));
+		txString(r->queryData);
+	}
+	txString(F(" HTTP/1.1\r\nHost: "));
+	txString(r->serverIP);
+	if (r->port != 80) {
+		txByte(':');
+		txNumber(r->port);
+	}
+	txString(F("\r\nConnection: keep-alive\r\nUser-Agent: ESP8266_HTTP_Client\r\n"));
+	if (extraHeaders != NULL) {
+		if (extraHeadersFlash) {
+			txString((const __FlashStringHelper *)extraHeaders);
+		}
+		else {
+			txString(extraHeaders);
+		}
+	}
+	ESP8266Cache *e = cacheFind(r, false);
+	if (e != NULL && e->type != CACHE_NONE) {
+		txString(e->type == CACHE_ETAG ? F("If-None-Match: ") : F("If-Modified-Since: "));
+		txString(e->validator);
+		txString(F("\r\n"));
+	}
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::requestBody(request *r) {
+	if (r->postFlash) {
+		txString((const __FlashStringHelper *)r->postData);
+	}
+	else {
+		txString(r->postData);
+	}
+}
+
+ESP8266_TEMPLATE
+size_t ESP8266_CLIENT::requestBodyLength(request *r) {
+	return r->postFlash ? strlen_P(r->postData) : strlen(r->postData);
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::txBegin(boolean send, size_t from, size_t to) {
+	txSend = send;
+	txFrom = from;
+	txTo = to;
+	txCount = 0;
+	txFill = 0;
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::txByte(char c) {
+	if (txSend && txCount >= txFrom && txCount < txTo) {
+		txBuffer[txFill] = c;
+		txFill++;
+		if (txFill == ESP8266_TX_BUFFER) {
+			txFlush();
+		}
+	}
+	txCount++;
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::txProducer(request *r) {
+	// only part of body inside window is produced, straight into tx buffer
+	size_t start = txCount;
+	size_t end = start + r->bodyLength;
+	if (txSend && txFrom < end && txTo > start) {
+		size_t offset = txFrom > start ? txFrom - start : 0;
+		size_t stop = (txTo < end ? txTo : end) - start;
+		while (offset < stop) {
+			size_t size = ESP8266_TX_BUFFER - txFill;
+			if (size > stop - offset) {
+				size = stop - offset;
+			}
+			if (r->producer(txBuffer + txFill, offset, size) != size) {
+				DBG(F("ESP8266 request body incomplete \r\n"));
+				txFailed = true;
+				break;
+			}
+			txFill += size;
+			offset += size;
+			if (txFill == ESP8266_TX_BUFFER) {
+				txFlush();
+			}
+		}
+	}
+	txCount = end;
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::txPad(size_t length) {
+	// module waits for announced number of bytes, empty lines are ignored by server
+	txBegin(true, 0, length);
+	while (txCount < length) {
+		txByte(txCount % 2 == 0 ? '\r' : '\n');
+	}
+	txFlush();
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::txString(const char s[]) {
+	while (*s != '\0') {
+		txByte(*s);
+		s++;
+	}
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::txString(const __FlashStringHelper *s) {
+	PGM_P p = reinterpret_cast<PGM_P>(s);
+	char c;
+	while ((c = pgm_read_byte(p)) != '\0') {
+		txByte(c);
+		p++;
+	}
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::txNumber(unsigned long n) {
+	char digits[10];
+	uint8_t i = 0;
+	do {
+		digits[i] = '0' + n % 10;
+		n /= 10;
+		i++;
+	} while (n > 0);
+	while (i > 0) {
+		i--;
+		txByte(digits[i]);
+	}
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::txFlush() {
+	if (txSend && txFill > 0) {
+		serial.write((const uint8_t *)txBuffer, txFill);
+		txWritten += txFill;
+	}
+	txFill = 0;
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::setHeaders(const char headers[]) {
+	extraHeaders = headers;
+	extraHeadersFlash = false;
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::setHeaders(const __FlashStringHelper *headers) {
+	extraHeaders = reinterpret_cast<const char *>(headers);
+	extraHeadersFlash = true;
+}
+
+
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::SendData(uint8_t serialResponseStatus) {
+	state = STATE_SENDING_DATA;
+	request *r = currentRequest();
+	if (serialResponseStatus == SERIAL_RESPONSE_TRUE) {
+		TRACE_LINK(r->link, TRACE_PROMPT);
+		if (pipelineWrite(r->link) != sendingTotal) {
+			// request data changed since first AT+CIPSEND
+			DBG(F("ESP8266 request length mismatch \r\n"));
+			txPad(sendingLength);
+			connectionRetry();
+			return;
+		}
+		txWritten = 0;
+		txFailed = false;
+		pipelineWrite(r->link, true, sendingOffset, sendingOffset + sendingLength);
+		if (txFailed) {
+			// request cannot be completed, it is dropped and connection closed
+			uint8_t link = r->link;
+			txPad(sendingLength - txWritten);
+			connectionDeliver(link, false);
+			connectionRequeue(link);
+			connections[link].state = LINK_CLOSING;
+			state = STATE_CONNECTED;
+			return;
+		}
+
+		setResponseTrueKeywords(KEYWORD_SEND_OK);
+		setResponseFalseKeywords(KEYWORD_ERROR);
+		readResponse(10000, &ESP8266Client::ConfirmSend);
+	}
+	else {
+		state = STATE_CONNECTED;
+		DBG(F("ESP8266 cannot send data \r\n"));
+		connectionRetry();
+	}
+
+	attemptCounter = 0;
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::ConfirmSend(uint8_t serialResponseStatus) {
+	state = STATE_CONNECTED;
+	if (serialResponseStatus == SERIAL_RESPONSE_TRUE) {
+		sendingOffset += sendingLength;
+		if (sendingOffset < sendingTotal) {
+			// next frame of long request
+			SendDataLength();
+			return;
+		}
+		DBG(F("ESP8266 request sended \r\n"));
+		responseWait();
+	}
+	else if (serialResponseStatus == SERIAL_RESPONSE_FALSE) {
+		DBG(buffer);
+		DBG(F("\r\nESP8266 data sending error \r\n"));
+		connectionRetry();
+	}
+	else {
+		DBG(buffer);
+		DBG(F("\r\nESP8266 data sending timeout \r\n"));
+		connectionRetry();
+	}
+}
+
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::responseWait() {
+	request *r = currentRequest();
+	TRACE_LINK(r->link, TRACE_SEND);
+	connection &c = connections[r->link];
+	c.streaming = HAS_STREAMING && (bodyChunkHandler != NULL || jsonExtractors != NULL);
+	c.state = LINK_WAITING;
+	c.timestamp = currentTimestamp;
+	if (multiplexing()) {
+		// response will be picked up from module output whenever it comes
+		return;
+	}
+	// "\r\nOK\r\n" after +IPD frame belongs to frame, end of response is found by
+	// http parser which finishes the wait
+	state = STATE_SENDING_DATA;
+	setResponseTrueKeywords();
+	setResponseFalseKeywords(KEYWORD_ERROR);
+	readResponse(ESP8266_RESPONSE_TIMEOUT, &ESP8266Client::ReadMessage);
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::ReadMessage(uint8_t serialResponseStatus) {
+	state = STATE_DATA_RECIVED;
+	// responses were handed over by http parser as they came, only broken one is left
+	if (serialResponseStatus != SERIAL_RESPONSE_TRUE && connections[0].state == LINK_WAITING) {
+		connectionDeliver(0, false);
+		connectionRequeue(0);
+	}
+	if (serialResponseStatus == SERIAL_RESPONSE_FALSE) {
+		DBG(F("\r\nESP8266 response msg error \r\n"));
+	}
+	else if (serialResponseStatus != SERIAL_RESPONSE_TRUE) {
+		DBG(F("\r\nESP8266 response msg timeout \r\n"));
+	}
+	state = STATE_CONNECTED;
+	if (serialResponseStatus != SERIAL_RESPONSE_TRUE && connections[0].state != LINK_FREE) {
+		connections[0].state = LINK_CLOSING;
+	}
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::setOnDataRecived(void(*handler)(int code, char data[])) {
+	dataRecivedHandler = handler;
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::setOnBodyChunk(void(*handler)(const char data[], size_t length)) {
+	bodyChunkHandler = handler;
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::setOnBodyEnd(void(*handler)(int code)) {
+	bodyEndHandler = handler;
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::setJsonExtractor(ESP8266Json extractors[], uint8_t count) {
+	jsonExtractors = extractors;
+	jsonExtractorsCount = extractors != NULL ? count : 0;
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::jsonClaim(uint8_t id) {
+	for (uint8_t j = 0; j < jsonExtractorsCount; j++) {
+		boolean used = false;
+		for (uint8_t l = 0; l < LINKS; l++) {
+			used = used || connections[l].json == j;
+		}
+		if (!used) {
+			connections[id].json = j;
+			jsonExtractors[j].begin();
+			return;
+		}
+	}
+	if (jsonExtractorsCount > 0) {
+		DBG(F("ESP8266 no free json extractor \r\n"));
+	}
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::setSink(ESP8266Sink *_sink) {
+	sink = _sink;
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::setOnBodyStored(void(*handler)(int code, uint16_t handle, uint32_t length)) {
+	bodyStoredHandler = handler;
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::sinkClaim(uint8_t id) {
+	connection &c = connections[id];
+	if (sink == NULL || sinkLink != LINK_NONE || bodyChunkHandler != NULL || c.batched
+		|| (c.httpContentLength != HTTP_LENGTH_UNKNOWN && c.httpContentLength < connectionBufferSize())) {
+		return;
+	}
+	uint16_t handle = sink->open(requests[c.pipeline[0]].id, c.httpContentLength);
+	if (handle == SINK_NONE) {
+		DBG(F("ESP8266 sink refused body \r\n"));
+		return;
+	}
+	sinkLink = id;
+	sinkHandle = handle;
+	sinkOffset = 0;
+	sinkBlocked = false;
+	// body goes to link part of buffer block by block, json extractor still gets it
+	c.streaming = false;
+}
+
+ESP8266_TEMPLATE
+boolean ESP8266_CLIENT::sinkFlush() {
+	connection &c = connections[sinkLink];
+	if (c.cursor == 0) {
+		sinkBlocked = false;
+		return true;
+	}
+	sinkBlocked = !sink->write(sinkOffset, (const uint8_t *)connectionBuffer(sinkLink), c.cursor);
+	if (sinkBlocked) {
+		return false;
+	}
+	sinkOffset += c.cursor;
+	c.cursor = 0;
+	return true;
+}
+
+// false while storage is busy, module output is not read meanwhile. Response waiting
+// for its last block is finished here once block is stored or ESP8266_SINK_TIMEOUT passes.
+ESP8266_TEMPLATE
+boolean ESP8266_CLIENT::sinkPoll() {
+	if (sinkBlocked && !sinkFlush()) {
+		if (sinkFinal == SINK_FINAL_NONE || currentTimestamp - sinkSince < ESP8266_SINK_TIMEOUT) {
+			return false;
+		}
+		DBG(F("ESP8266 sink timeout \r\n"));
+	}
+	if (sinkFinal == SINK_FINAL_DONE) {
+		connectionDone(sinkLink);
+	}
+	else if (sinkFinal == SINK_FINAL_CLOSED) {
+		connectionClosed(sinkLink);
+	}
+	return true;
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::sinkClose(int code) {
+	sink->close(code != HTTP_CODE_BROKEN && code != SINK_ABORTED);
+	sinkLink = LINK_NONE;
+	sinkBlocked = false;
+	sinkFinal = SINK_FINAL_NONE;
+	if (code != SINK_ABORTED && bodyStoredHandler != NULL) {
+		bodyStoredHandler(code, sinkHandle, sinkOffset);
+	}
+}
+
+ESP8266_TEMPLATE
+size_t ESP8266_CLIENT::getResponseLength() {
+	return responseLength;
+}
+
+ESP8266_TEMPLATE
+int ESP8266_CLIENT::getResponseCode() {
+	return responseCode;
+}
+
+
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::demuxReset() {
+	ipdState = IPD_SEARCH;
+	ipdProgress = 0;
+	ipdLeft = 0;
+	ipdTrailer = IPD_TRAILER_OFF;
+	closedProgress = 0;
+	unlinkProgress = 0;
+	lineStart = true;
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::rxEvent() {
+	while (true) {
+		uint8_t used = rxHead - rxTail;
+		if (used == ESP8266_RX_RING) {
+			if (serial.available() > 0) {
+				// ring is full, rest waits in serial port and may overflow there
+				rxOverruns++;
+			}
+			return;
+		}
+		// free part of ring up to its end, in one block
+		uint8_t at = rxHead & (ESP8266_RX_RING - 1);
+		uint8_t room = ESP8266_RX_RING - used;
+		if (room > ESP8266_RX_RING - at) {
+			room = ESP8266_RX_RING - at;
+		}
+		uint8_t n = esp8266Read(&serial, rxRing + at, room);
+		if (n == 0) {
+			return;
+		}
+		// slots are written before consumer can see them
+		rxHead = rxHead + n;
+		if (used + n > rxPeak) {
+			rxPeak = used + n;
+		}
+	}
+}
+
+ESP8266_TEMPLATE
+unsigned long ESP8266_CLIENT::getRxOverruns() {
+	// four bytes, interrupt could change them half way
+	noInterrupts();
+	unsigned long overruns = rxOverruns;
+	interrupts();
+	return overruns;
+}
+
+ESP8266_TEMPLATE
+uint8_t ESP8266_CLIENT::getRxPeak() {
+	return rxPeak;
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::rxPoll() {
+	if (HAS_STREAMING && !sinkPoll()) {
+		return;
+	}
+	while (true) {
+		// producer may also be interrupt, it must not run in the middle of this one
+		noInterrupts();
+		rxEvent();
+		interrupts();
+		if (rxTail == rxHead) {
+			return;
+		}
+		while (rxTail != rxHead) {
+			if (HAS_STREAMING && !sinkPoll()) {
+				// storage is busy, bytes wait in ring and serial port
+				return;
+			}
+			char c = rxRing[rxTail & (ESP8266_RX_RING - 1)];
+			rxTail = rxTail + 1;
+			rxByte(c);
+		}
+	}
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::rxByte(char c) {
+	if (passthrough) {
+		// raw server data, no +IPD frames
+		connectionByte(0, c);
+		return;
+	}
+	// frame payload, goes to http parser of its link only
+	if (ipdLeft > 0) {
+		connectionByte(ipdLink, c);
+		ipdLeft--;
+		if (ipdLeft == 0) {
+			ipdTrailer = 0;
+			if (ipdLink < LINKS && connections[ipdLink].state == LINK_WAITING) {
+				if (HAS_STREAMING && connections[ipdLink].streaming) {
+					connectionFlush(ipdLink);
+				}
+				// without Content-Length response ends with frame, stored one spans
+				// frames until server closes connection
+				if (connections[ipdLink].httpPhase == HTTP_BODY && connections[ipdLink].httpContentLength == HTTP_LENGTH_UNKNOWN
+					&& !(HAS_STREAMING && sinkLink == ipdLink)) {
+					connectionDone(ipdLink);
+				}
+			}
+		}
+		return;
+	}
+
+	if (ipdState == IPD_LENGTH) {
+		if (c >= '0' && c <= '9') {
+			ipdLength = ipdLength * 10 + (c - '0');
+		}
+		else if (c == ',' && ipdLink == LINK_NONE) {
+			// "+IPD,<id>,<len>:" in multiple connections mode
+			ipdLink = ipdLength;
+			ipdLength = 0;
+		}
+		else {
+			ipdState = IPD_SEARCH;
+			if (c == ':') {
+				ipdLeft = ipdLength;
+			}
+		}
+		return;
+	}
+
+	// firmware closes every frame with OK, it is not a response to AT command
+	if (ipdTrailer != IPD_TRAILER_OFF) {
+		if (c == keywordChar(KEYWORD_IPD_TRAILER, ipdTrailer)) {
+			ipdTrailer++;
+			if (keywordChar(KEYWORD_IPD_TRAILER, ipdTrailer) == '\0') {
+				ipdTrailer = IPD_TRAILER_OFF;
+				// "<id>,CLOSED" may follow right away
+				lineStart = true;
+			}
+			return;
+		}
+		// not a trailer after all, pass on what was held back
+		uint8_t held = ipdTrailer;
+		ipdTrailer = IPD_TRAILER_OFF;
+		for (uint8_t i = 0; i < held; i++) {
+			commandByte(keywordChar(KEYWORD_IPD_TRAILER, i));
+		}
+	}
+
+	commandByte(c);
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::commandByte(char c) {
+	if (state == STATE_RECIVING_DATA) {
+		// in single connection mode response body uses whole buffer
+		if ((multiplexing() || connections[0].state != LINK_WAITING) && bufferCursor < (bufferSize - 1)) {
+			buffer[bufferCursor] = c;
+			bufferCursor++;
+			buffer[bufferCursor] = '\0';
+			if (bufferCursor > bufferPeak) {
+				bufferPeak = bufferCursor;
+			}
+		}
+		keywordsMatch(c);
+	}
+
+	if (keywordStep(KEYWORD_IPD, ipdProgress, c)) {
+		ipdState = IPD_LENGTH;
+		ipdLength = 0;
+		ipdLink = multiplexing() ? LINK_NONE : 0;
+	}
+
+	if (lineStart) {
+		lineFirst = c;
+	}
+	lineStart = c == '\n';
+	if (keywordStep(KEYWORD_CLOSED, closedProgress, c)) {
+		connectionClosed(multiplexing() ? lineFirst - '0' : 0);
+	}
+	if (keywordStep(KEYWORD_UNLINK, unlinkProgress, c) && !multiplexing()) {
+		connectionClosed(0);
+	}
+}
+
+
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::connectionsReset() {
+	for (uint8_t l = 0; l < LINKS; l++) {
+		// requests sent over closed links are sent again
+		if (connections[l].state != LINK_FREE) {
+			connectionRequeue(l);
+		}
+		if (HAS_STREAMING && sinkLink == l) {
+			// request goes again, body will be stored from scratch
+			sinkClose(SINK_ABORTED);
+		}
+		connectionReset(l);
+		connections[l].state = LINK_FREE;
+		connections[l].serverIP = NULL;
+		connections[l].port = 0;
+		connections[l].pipelined = 0;
+		connections[l].answered = false;
+	}
+	demuxReset();
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::connectionsUpdate() {
+	for (uint8_t l = 0; l < LINKS; l++) {
+		if (connections[l].state == LINK_WAITING
+			&& ((currentTimestamp - connections[l].timestamp) > ESP8266_RESPONSE_TIMEOUT || currentTimestamp < connections[l].timestamp)) {
+			DBG(F("ESP8266 response msg timeout \r\n"));
+			connectionDeliver(l, false);
+			connectionRequeue(l);
+			connections[l].state = LINK_CLOSING;
+		}
+	}
+}
+
+ESP8266_TEMPLATE
+uint8_t ESP8266_CLIENT::connectionsCount() {
+	return multiplexing() ? LINKS : 1;
+}
+
+ESP8266_TEMPLATE
+boolean ESP8266_CLIENT::connectionMatches(uint8_t id, request *r) {
+	connection &c = connections[id];
+	return c.serverIP != NULL && c.port == r->port
+		&& (c.serverIP == r->serverIP || strcmp(c.serverIP, r->serverIP) == 0);
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::connectionRelease(uint8_t id) {
+	connections[id].timestamp = currentTimestamp;
+	connections[id].state = keepAliveTimeout > 0 ? LINK_IDLE : LINK_CLOSING;
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::connectionReset(uint8_t id) {
+	connection &c = connections[id];
+	c.cursor = 0;
+	c.overflow = false;
+	c.httpPhase = HTTP_STATUS;
+	c.httpCode = 0;
+	c.httpHeaderProgress = 0;
+	c.httpLineEmpty = true;
+	c.httpContentLength = HTTP_LENGTH_UNKNOWN;
+	c.httpBodyRecived = 0;
+	c.rxBytes = 0;
+	c.json = JSON_NONE;
+}
+
+ESP8266_TEMPLATE
+char* ESP8266_CLIENT::connectionBuffer(uint8_t id) {
+	if (!multiplexing()) {
+		return buffer;
+	}
+	return buffer + ESP8266_MUX_CMD_BUFFER + id * connectionBufferSize();
+}
+
+ESP8266_TEMPLATE
+uint16_t ESP8266_CLIENT::connectionBufferSize() {
+	if (!multiplexing()) {
+		return RxSize;
+	}
+	return (RxSize - ESP8266_MUX_CMD_BUFFER) / LINKS;
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::connectionByte(uint8_t id, char ch) {
+	if (id >= LINKS || connections[id].state != LINK_WAITING) {
+		return;
+	}
+	connection &c = connections[id];
+
+	if (c.rxBytes == 0) {
+		c.rxStarted = micros();
+		TRACE(c.pipeline[0], TRACE_SERVER);
+	}
+	c.rxBytes++;
+
+	switch (c.httpPhase) {
+	case HTTP_STATUS:
+		// "HTTP/1.1 200 OK", code is between first and second space, anything before
+		// it (like space after transparent mode prompt) is skipped
+		if (c.httpLineEmpty && (ch == ' ' || ch == '\r' || ch == '\n')) {
+			break;
+		}
+		c.httpLineEmpty = false;
+		if (ch == ' ') {
+			c.httpHeaderProgress++;
+		}
+		else if (ch == '\n') {
+			c.httpPhase = HTTP_HEADERS;
+			c.httpHeaderProgress = 0;
+			c.httpLineEmpty = true;
+			if (c.httpCode == 200) {
+				// new version, its validator (if any) comes in headers
+				ESP8266Cache *e = cacheFind(&requests[c.pipeline[0]], false);
+				if (e != NULL) {
+					e->key = 0;
+				}
+			}
+		}
+		else if (c.httpHeaderProgress == 1 && ch >= '0' && ch <= '9') {
+			c.httpCode = c.httpCode * 10 + (ch - '0');
+		}
+		break;
+
+	case HTTP_HEADERS:
+		if (ch == '\n') {
+			if (!c.httpLineEmpty && cache != NULL && c.httpCode == 200) {
+				cacheHeader(id);
+			}
+			c.cursor = 0;
+			if (c.httpLineEmpty) {
+				c.httpPhase = HTTP_BODY;
+				if (c.httpCode == 304 || c.httpCode == 204) {
+					// never has body
+					c.httpContentLength = 0;
+				}
+				if (HAS_STREAMING) {
+					jsonClaim(id);
+					sinkClaim(id);
+				}
+				if (c.httpContentLength == 0) {
+					c.httpPhase = HTTP_DONE;
+					connectionDone(id);
+				}
+			}
+			c.httpHeaderProgress = 0;
+			c.httpLineEmpty = true;
+			break;
+		}
+		if (ch != '\r') {
+			c.httpLineEmpty = false;
+			if (cache != NULL && c.cursor < connectionBufferSize() - 1) {
+				connectionBuffer(id)[c.cursor] = ch;
+				c.cursor++;
+			}
+		}
+		// only Content-Length is interesting, name is matched case insensitive,
+		// progress past the name means value digits are being read
+		if (c.httpHeaderProgress < KEYWORD_LENGTH - 1) {
+			if ((ch | 0x20) == keywordChar(KEYWORD_CONTENT_LENGTH, c.httpHeaderProgress)) {
+				c.httpHeaderProgress++;
+				if (keywordChar(KEYWORD_CONTENT_LENGTH, c.httpHeaderProgress) == '\0') {
+					// past the name, value digits follow
+					c.httpHeaderProgress = KEYWORD_LENGTH - 1;
+					c.httpContentLength = 0;
+				}
+			}
+			else {
+				c.httpHeaderProgress = 0xFF;
+			}
+		}
+		else if (c.httpHeaderProgress != 0xFF && ch >= '0' && ch <= '9') {
+			c.httpContentLength = c.httpContentLength * 10 + (ch - '0');
+		}
+		break;
+
+	case HTTP_BODY:
+		if (HAS_STREAMING && c.json != JSON_NONE) {
+			responseRequestId = requests[c.pipeline[0]].id;
+			responseCode = c.httpCode;
+			jsonExtractors[c.json].feed(ch);
+		}
+		if (c.cursor == (connectionBufferSize() - 1)) {
+			if (HAS_STREAMING && c.streaming) {
+				connectionFlush(id);
+			}
+			else {
+				c.overflow = true;
+			}
+		}
+		if (c.cursor < (connectionBufferSize() - 1)) {
+			connectionBuffer(id)[c.cursor] = ch;
+			c.cursor++;
+			if (c.cursor > bufferPeak) {
+				bufferPeak = c.cursor;
+			}
+		}
+		if (HAS_STREAMING && sinkLink == id && c.cursor == SINK_BLOCK) {
+			sinkFlush();
+		}
+		c.httpBodyRecived++;
+		if (c.httpBodyRecived == c.httpContentLength) {
+			c.httpPhase = HTTP_DONE;
+			connectionDone(id);
+		}
+		break;
+	}
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::connectionFlush(uint8_t id) {
+	connection &c = connections[id];
+	if (c.cursor > 0) {
+		char *b = connectionBuffer(id);
+		b[c.cursor] = '\0';
+		responseRequestId = requests[c.pipeline[0]].id;
+		responseCode = c.httpCode;
+		if (bodyChunkHandler != NULL) {
+			bodyChunkHandler(b, c.cursor);
+		}
+		c.cursor = 0;
+	}
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::connectionDone(uint8_t id) {
+	connection &c = connections[id];
+	if (c.state != LINK_WAITING) {
+		return;
+	}
+	if (HAS_STREAMING && sinkLink == id && sinkFinal == SINK_FINAL_NONE && !sinkFlush()) {
+		// last block waits for busy storage, sinkPoll() comes back
+		sinkFinal = SINK_FINAL_DONE;
+		sinkSince = currentTimestamp;
+		return;
+	}
+	connectionDeliver(id, true);
+	if (c.pipelined > 0) {
+		// next pipelined response follows
+		connectionReset(id);
+		c.answered = true;
+		c.timestamp = currentTimestamp;
+		return;
+	}
+	connectionRelease(id);
+	if (!multiplexing()) {
+		// ends ReadMessage wait
+		responseMatch = SERIAL_RESPONSE_TRUE;
+	}
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::connectionClosed(uint8_t id) {
+	if (id >= connectionsCount()) {
+		return;
+	}
+	connection &c = connections[id];
+	// socket closed by server ends response without Content-Length, but response
+	// to pipelined request not even started means server has not read the request
+	if (!(c.answered && c.httpPhase == HTTP_STATUS && c.httpHeaderProgress == 0)) {
+		connectionDone(id);
+	}
+	if (HAS_STREAMING && sinkLink == id && sinkFinal != SINK_FINAL_NONE) {
+		// response is finished and link freed once its last block is stored
+		sinkFinal = SINK_FINAL_CLOSED;
+		return;
+	}
+	if (c.state == LINK_WAITING) {
+		// rest of pipeline was not answered
+		connectionRequeue(id);
+		if (!multiplexing()) {
+			responseMatch = SERIAL_RESPONSE_TRUE;
+		}
+	}
+	if (c.state != LINK_CONNECTING) {
+		c.state = LINK_FREE;
+	}
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::connectionDeliver(uint8_t id, boolean recived) {
+	connection &c = connections[id];
+	// last block was offered to storage by connectionDone()
+	boolean stored = !(HAS_STREAMING && sinkLink == id && sinkBlocked);
+	char *b = connectionBuffer(id);
+	boolean complete = recived && !c.overflow && stored
+		&& (c.httpPhase == HTTP_DONE || (c.httpPhase == HTTP_BODY && c.httpContentLength == HTTP_LENGTH_UNKNOWN));
+	int code = complete ? c.httpCode : HTTP_CODE_BROKEN;
+	if (cache != NULL) {
+		cacheStore(id, complete);
+	}
+
+	// effective speed of module output, short responses say more about latency
+	unsigned long elapsed = micros() - c.rxStarted;
+	if (recived && c.rxBytes >= ESP8266_BYTE_RATE_MIN && elapsed > 0) {
+		byteRate = (unsigned long)((unsigned long long)c.rxBytes * 1000000 / elapsed);
+	}
+
+	if (HAS_STREAMING && c.json != JSON_NONE) {
+		jsonExtractors[c.json].end();
+		c.json = JSON_NONE;
+	}
+	if (HAS_STREAMING && sinkLink == id) {
+		responseRequestId = requests[c.pipeline[0]].id;
+		responseCode = code;
+		sinkClose(code);
+	}
+	else if (HAS_STREAMING && c.streaming) {
+		connectionFlush(id);
+		responseRequestId = requests[c.pipeline[0]].id;
+		responseCode = code;
+		if (!complete) {
+			DBG(F("ESP8266 response stream broken \r\n"));
+		}
+		if (bodyEndHandler != NULL) {
+			bodyEndHandler(code);
+		}
+	}
+	else if (recived) {
+		b[c.cursor] = '\0';
+		responseRequestId = requests[c.pipeline[0]].id;
+		responseCode = code;
+		responseLength = c.cursor;
+		if (code == 304) {
+			ESP8266Cache *e = cacheFind(&requests[c.pipeline[0]], false);
+			if (e != NULL && e->length != CACHE_NO_BODY) {
+				b = e->body;
+				responseLength = e->length;
+			}
+		}
+		if (dataRecivedHandler != NULL) {
+			dataRecivedHandler(code, b);
+		}
+		else {
+			DBG(b);
+		}
+	}
+	else if (c.batched) {
+		// batch is not sent again, every POST of it ends here
+		requestEnd(requests[c.pipeline[0]].id, code);
+	}
+
+	if (HAS_TRACING) {
+		traceFinish(id, code);
+	}
+	connectionShift(id);
+
+	// rest of batch gets the same response
+	while (c.batched && c.pipelined > 0) {
+		uint8_t requestId = requests[c.pipeline[0]].id;
+		if (HAS_TRACING) {
+			traceFinish(id, code);
+		}
+		connectionShift(id);
+		if (recived && !(HAS_STREAMING && c.streaming)) {
+			responseRequestId = requestId;
+			if (dataRecivedHandler != NULL) {
+				dataRecivedHandler(code, b);
+			}
+		}
+		else {
+			requestEnd(requestId, code);
+		}
+	}
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::traceMark(uint8_t slot, uint8_t stage) {
+	request &r = requests[slot];
+	if (stage == TRACE_QUEUE) {
+		// request sent again starts its timeline over, only time in queue is kept
+		for (uint8_t s = 0; s < TRACE_TOTAL; s++) {
+			r.trace[s] = TRACE_NONE;
+		}
+	}
+	unsigned long elapsed = millis() - r.timestamp;
+	r.trace[stage] = elapsed < TRACE_NONE ? elapsed : TRACE_NONE - 1;
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::traceLink(uint8_t id, uint8_t stage) {
+	connection &c = connections[id];
+	for (uint8_t p = 0; p < c.pipelined; p++) {
+		traceMark(c.pipeline[p], stage);
+	}
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::traceFinish(uint8_t id, int code) {
+	connection &c = connections[id];
+	if (c.pipelined == 0) {
+		return;
+	}
+	traceMark(c.pipeline[0], TRACE_RECIVE);
+	traceRequest(c.pipeline[0], id, code);
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::traceRequest(uint8_t slot, uint8_t link, int code) {
+	request &r = requests[slot];
+	ESP8266Trace t;
+	t.id = r.id;
+	t.link = link;
+	t.code = code;
+	uint16_t previous = 0;
+	for (uint8_t s = 0; s < TRACE_TOTAL; s++) {
+		t.stage[s] = TRACE_NONE;
+		if (r.trace[s] != TRACE_NONE) {
+			t.stage[s] = r.trace[s] - previous;
+			previous = r.trace[s];
+		}
+	}
+	// request which was not sent ends with its time in queue
+	t.stage[TRACE_TOTAL] = previous;
+
+	for (uint8_t s = 0; s < TRACE_STAGES; s++) {
+		if (t.stage[s] == TRACE_NONE) {
+			continue;
+		}
+		uint8_t b = 0;
+		while (b < TRACE_BUCKETS - 1 && t.stage[s] >= pgm_read_word(&traceLimits[b])) {
+			b++;
+		}
+		if (latency[s][b] < 0xFFFF) {
+			latency[s][b]++;
+		}
+	}
+	if (traceHandler != NULL) {
+		traceHandler(t);
+	}
+}
+
+ESP8266_TEMPLATE
+uint16_t ESP8266_CLIENT::getLatencyCount(uint8_t stage, uint8_t bucket) {
+	if (!HAS_TRACING || stage >= TRACE_STAGES || bucket >= TRACE_BUCKETS) {
+		return 0;
+	}
+	return latency[stage][bucket];
+}
+
+ESP8266_TEMPLATE
+uint16_t ESP8266_CLIENT::getLatencyLimit(uint8_t bucket) {
+	if (bucket >= TRACE_BUCKETS - 1) {
+		return TRACE_NONE;
+	}
+	return pgm_read_word(&traceLimits[bucket]);
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::clearLatency() {
+	memset(latency, 0, sizeof(latency));
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::setOnTrace(void(*handler)(const ESP8266Trace &trace)) {
+	traceHandler = handler;
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::connectionShift(uint8_t id) {
+	connection &c = connections[id];
+	if (c.pipelined == 0) {
+		return;
+	}
+	if (sendingRequest == c.pipeline[0]) {
+		sendingRequest = REQUEST_NONE;
+	}
+	requestRelease(c.pipeline[0]);
+	c.pipelined--;
+	for (uint8_t p = 0; p < c.pipelined; p++) {
+		c.pipeline[p] = c.pipeline[p + 1];
+	}
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::connectionRequeue(uint8_t id) {
+	connection &c = connections[id];
+	// backwards, so requests keep their order at front of queue
+	while (c.pipelined > 0) {
+		c.pipelined--;
+		requests[c.pipeline[c.pipelined]].link = LINK_NONE;
+		queuePush(c.pipeline[c.pipelined], true);
+	}
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::connectionAssign(uint8_t id, uint8_t slot) {
+	connection &c = connections[id];
+	connectionReset(id);
+	c.state = LINK_CONNECTING;
+	c.pipeline[0] = slot;
+	c.pipelined = 1;
+	c.batched = false;
+	c.answered = false;
+	queuePop(slot);
+	requests[slot].link = id;
+	sendingRequest = slot;
+	sendingOffset = 0;
+	pipelineFill(id);
+	TRACE_LINK(id, TRACE_QUEUE);
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::connectionRetry() {
+	request *r = currentRequest();
+	if (r != NULL && r->link != LINK_NONE) {
+		connections[r->link].state = LINK_CLOSING;
+		connectionRequeue(r->link);
+	}
+	state = STATE_CONNECTED;
+}
+
+
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::setDnsTtl(unsigned long ttl) {
+	dnsTtl = ttl;
+	if (ttl == 0) {
+		for (uint8_t i = 0; i < DNS_ENTRIES; i++) {
+			dnsCache[i].host[0] = '\0';
+		}
+	}
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::setHosts(const ESP8266Host _hosts[], uint8_t count) {
+	hosts = _hosts;
+	hostsCount = _hosts != NULL ? count : 0;
+}
+
+ESP8266_TEMPLATE
+uint8_t ESP8266_CLIENT::getHostFailures(const char serverIP[], uint16_t port) {
+	hostHealth *h = hostFind(hostKey(serverIP, port));
+	return h != NULL ? h->failures : 0;
+}
+
+ESP8266_TEMPLATE
+uint16_t ESP8266_CLIENT::hashAdd(uint16_t key, const char s[]) {
+	for (const char *c = s; *c != '\0'; c++) {
+		key = (key ^ (uint8_t)*c) * 0x0193;
+	}
+	return key;
+}
+
+ESP8266_TEMPLATE
+uint16_t ESP8266_CLIENT::hostKey(const char serverIP[], uint16_t port) {
+	// colliding hosts only share their backoff
+	uint16_t key = hashAdd(0x811C, serverIP);
+	key = (key ^ (port & 0xFF)) * 0x0193;
+	key = (key ^ (port >> 8)) * 0x0193;
+	return key != 0 ? key : 1;
+}
+
+ESP8266_TEMPLATE
+typename ESP8266_CLIENT::hostHealth* ESP8266_CLIENT::hostFind(uint16_t key) {
+	for (uint8_t i = 0; i < ESP8266_HOST_ENTRIES; i++) {
+		if (health[i].key == key) {
+			return &health[i];
+		}
+	}
+	return NULL;
+}
+
+ESP8266_TEMPLATE
+uint8_t ESP8266_CLIENT::hostState(request *r) {
+	hostHealth *h = hostFind(hostKey(r->serverIP, r->port));
+	// signed difference survives millis() overflow
+	if (h == NULL || (long)(currentTimestamp - h->retryAt) >= 0) {
+		return HOST_READY;
+	}
+	return h->failures < ESP8266_BREAKER_FAILURES ? HOST_BACKOFF : HOST_BROKEN;
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::hostFailed(request *r) {
+	uint16_t key = hostKey(r->serverIP, r->port);
+	hostHealth *h = hostFind(key);
+	if (h == NULL) {
+		// free entry or the one failing least
+		h = &health[0];
+		for (uint8_t i = 1; i < ESP8266_HOST_ENTRIES && h->key != 0; i++) {
+			if (health[i].key == 0 || health[i].failures < h->failures) {
+				h = &health[i];
+			}
+		}
+		h->key = key;
+		h->failures = 0;
+	}
+	if (h->failures < 0xFF) {
+		h->failures++;
+	}
+	unsigned long wait = ESP8266_BREAKER_TIMEOUT;
+	if (h->failures < ESP8266_BREAKER_FAILURES) {
+		wait = ESP8266_BACKOFF_BASE;
+		for (uint8_t i = 1; i < h->failures && wait < ESP8266_BACKOFF_MAX; i++) {
+			wait *= 2;
+		}
+		if (wait > ESP8266_BACKOFF_MAX) {
+			wait = ESP8266_BACKOFF_MAX;
+		}
+	}
+	else {
+		DBG(F("ESP8266 host circuit breaker open \r\n"));
+	}
+	// half of delay is random, hosts failing together do not come back together
+	wait = wait / 2 + random(wait / 2 + 1);
+	h->retryAt = currentTimestamp + wait;
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::hostSucceeded(request *r) {
+	hostHealth *h = hostFind(hostKey(r->serverIP, r->port));
+	if (h != NULL) {
+		h->key = 0;
+	}
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::setCache(ESP8266Cache entries[], uint8_t count) {
+	cache = entries;
+	cacheCount = entries != NULL ? count : 0;
+	for (uint8_t i = 0; i < cacheCount; i++) {
+		cache[i].key = 0;
+	}
+}
+
+ESP8266_TEMPLATE
+ESP8266Cache* ESP8266_CLIENT::cacheFind(request *r, boolean add) {
+	if (cache == NULL || strcmp_P(r->method, PSTR(METHOD_GET)) != 0) {
+		return NULL;
+	}
+	uint16_t key = hashAdd(hostKey(r->serverIP, r->port), r->url);
+	// 16 bit key alone collides, urls sharing it are told apart by second hash and length
+	uint16_t check = cacheCheck(cacheCheck(r->port, r->serverIP), r->url);
+	uint16_t length = strlen(r->url);
+	if (r->queryData != NULL) {
+		key = hashAdd(hashAdd(key, "?"), r->queryData);
+		check = cacheCheck(cacheCheck(check, "?"), r->queryData);
+		length += 1 + strlen(r->queryData);
+	}
+	if (key == 0) {
+		key = 1;
+	}
+	ESP8266Cache *e = NULL;
+	for (uint8_t i = 0; i < cacheCount; i++) {
+		if (cache[i].key == key && cache[i].check == check && cache[i].urlLength == length) {
+			cache[i].used = currentTimestamp;
+			return &cache[i];
+		}
+		// free entry or least recently used one
+		if (e == NULL || (e->key != 0 && (cache[i].key == 0 || (long)(cache[i].used - e->used) < 0))) {
+			e = &cache[i];
+		}
+	}
+	if (!add || e == NULL) {
+		return NULL;
+	}
+	e->key = key;
+	e->check = check;
+	e->urlLength = length;
+	e->type = CACHE_NONE;
+	e->length = CACHE_NO_BODY;
+	e->used = currentTimestamp;
+	return e;
+}
+
+ESP8266_TEMPLATE
+uint16_t ESP8266_CLIENT::cacheCheck(uint16_t check, const char s[]) {
+	for (const char *c = s; *c != '\0'; c++) {
+		check = check * 31 + (uint8_t)*c;
+	}
+	return check;
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::cacheHeader(uint8_t id) {
+	connection &c = connections[id];
+	char *line = connectionBuffer(id);
+	line[c.cursor] = '\0';
+	uint8_t keyword = KEYWORD_ETAG;
+	uint8_t type = CACHE_ETAG;
+	uint8_t i = 0;
+	// name is matched case insensitive
+	while (keywordChar(keyword, i) != '\0' && (line[i] | 0x20) == keywordChar(keyword, i)) {
+		i++;
+	}
+	if (keywordChar(keyword, i) != '\0') {
+		keyword = KEYWORD_LAST_MODIFIED;
+		type = CACHE_DATE;
+		i = 0;
+		while (keywordChar(keyword, i) != '\0' && (line[i] | 0x20) == keywordChar(keyword, i)) {
+			i++;
+		}
+		if (keywordChar(keyword, i) != '\0') {
+			return;
+		}
+	}
+	while (line[i] == ' ') {
+		i++;
+	}
+	ESP8266Cache *e = cacheFind(&requests[c.pipeline[0]], true);
+	// ETag is preferred, it is exact
+	if (e == NULL || strlen(line + i) >= ESP8266_CACHE_VALIDATOR || (e->type == CACHE_ETAG && type == CACHE_DATE)) {
+		return;
+	}
+	e->type = type;
+	strcpy(e->validator, line + i);
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::cacheStore(uint8_t id, boolean complete) {
+	connection &c = connections[id];
+	ESP8266Cache *e = cacheFind(&requests[c.pipeline[0]], false);
+	if (e == NULL || c.httpCode != 200) {
+		return;
+	}
+	if (!complete) {
+		// server may not have sent what validator stands for
+		e->key = 0;
+		return;
+	}
+	e->length = CACHE_NO_BODY;
+	if (e->body != NULL && c.cursor < e->size && !c.streaming && sinkLink != id) {
+		memcpy(e->body, connectionBuffer(id), c.cursor);
+		e->body[c.cursor] = '\0';
+		e->length = c.cursor;
+	}
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::hostsClear() {
+	for (uint8_t i = 0; i < ESP8266_HOST_ENTRIES; i++) {
+		health[i].key = 0;
+	}
+}
+
+ESP8266_TEMPLATE
+const char* ESP8266_CLIENT::hostsFind(const char host[]) {
+	for (uint8_t i = 0; i < hostsCount; i++) {
+		if (strcmp(hosts[i].host, host) == 0) {
+			return hosts[i].ip;
+		}
+	}
+	return NULL;
+}
+
+ESP8266_TEMPLATE
+typename ESP8266_CLIENT::dnsEntry* ESP8266_CLIENT::dnsFind(const char host[]) {
+	for (uint8_t i = 0; i < DNS_ENTRIES; i++) {
+		dnsEntry &e = dnsCache[i];
+		if (e.host[0] != '\0' && strcmp(e.host, host) == 0) {
+			if ((long)(e.expires - currentTimestamp) > 0) {
+				return &e;
+			}
+			e.host[0] = '\0';
+		}
+	}
+	return NULL;
+}
+
+ESP8266_TEMPLATE
+boolean ESP8266_CLIENT::dnsNeeded(const char host[]) {
+	// dotted address needs no lookup
+	boolean name = false;
+	for (const char *c = host; *c != '\0'; c++) {
+		name = name || ((*c < '0' || *c > '9') && *c != '.');
+	}
+	return HAS_DNS && name && dnsTtl > 0 && !dnsUnsupported && strlen(host) < ESP8266_DNS_HOST
+		&& hostsFind(host) == NULL && dnsFind(host) == NULL;
+}
+
+ESP8266_TEMPLATE
+boolean ESP8266_CLIENT::dnsStore(const char host[], const char address[]) {
+	uint8_t ip[4];
+	if (*address == '"') {
+		address++;
+	}
+	for (uint8_t i = 0; i < 4; i++) {
+		if (*address < '0' || *address > '9') {
+			return false;
+		}
+		int octet = atoi(address);
+		if (octet > 255) {
+			return false;
+		}
+		ip[i] = octet;
+		while (*address >= '0' && *address <= '9') {
+			address++;
+		}
+		if (i < 3 && *address++ != '.') {
+			return false;
+		}
+	}
+
+	// free entry, otherwise the one expiring first
+	dnsEntry *e = &dnsCache[0];
+	for (uint8_t i = 0; i < DNS_ENTRIES; i++) {
+		if (dnsCache[i].host[0] == '\0') {
+			e = &dnsCache[i];
+			break;
+		}
+		if ((long)(dnsCache[i].expires - e->expires) < 0) {
+			e = &dnsCache[i];
+		}
+	}
+	strcpy(e->host, host);
+	memcpy(e->ip, ip, 4);
+	e->expires = currentTimestamp + dnsTtl;
+	return true;
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::dnsEvict(request *r) {
+	// address may be stale, next connect looks hostname up again
+	dnsEntry *e = r != NULL ? dnsFind(r->serverIP) : NULL;
+	if (e != NULL) {
+		e->host[0] = '\0';
+	}
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::printAddress(const char host[]) {
+	const char *ip = hostsFind(host);
+	dnsEntry *e = ip == NULL && dnsTtl > 0 ? dnsFind(host) : NULL;
+	if (ip != NULL) {
+		serial.print(ip);
+	}
+	else if (e != NULL) {
+		for (uint8_t i = 0; i < 4; i++) {
+			if (i > 0) {
+				serial.print('.');
+			}
+			serial.print(e->ip[i]);
+		}
+	}
+	else {
+		serial.print(host);
+	}
+}
+
+
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::setTransparent(char serverIP[], uint16_t port) {
+	transparentIP = serverIP;
+	transparentPort = port;
+}
+
+ESP8266_TEMPLATE
+boolean ESP8266_CLIENT::transparentMatches(request *r) {
+	return !multiplexing() && transparentIP != NULL && r->port == transparentPort
+		&& (r->serverIP == transparentIP || strcmp(r->serverIP, transparentIP) == 0);
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::confTransparent(boolean enable) {
+	state = STATE_SENDING_DATA;
+	serial.print(F("AT+CIPMODE="));
+	serial.println(enable ? 1 : 0);
+
+	setResponseTrueKeywords(KEYWORD_OK);
+	setResponseFalseKeywords(KEYWORD_ERROR);
+	readResponse(2000, &ESP8266Client::PostConfTransparent);
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::PostConfTransparent(uint8_t serialResponseStatus) {
+	state = STATE_CONNECTED;
+	if (serialResponseStatus == SERIAL_RESPONSE_TRUE) {
+		transparentMode = !transparentMode;
+	}
+	else if (!transparentMode) {
+		DBG(F("ESP8266 transparent mode not supported \r\n"));
+		transparentIP = NULL;
+	}
+	else {
+		DBG(F("ESP8266 transparent mode cannot be left \r\n"));
+		softReset();
+	}
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::PostPassthroughStart(uint8_t serialResponseStatus) {
+	state = STATE_SENDING_DATA;
+	if (serialResponseStatus == SERIAL_RESPONSE_TRUE) {
+		TRACE_LINK(currentRequest()->link, TRACE_PROMPT);
+		passthrough = true;
+		passthroughSend();
+	}
+	else {
+		DBG(F("ESP8266 cannot start transparent transmission \r\n"));
+		connectionRetry();
+	}
+	attemptCounter = 0;
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::passthroughSend() {
+	pipelineWrite(0, true);
+	responseWait();
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::dispatchPassthrough() {
+	connection &c = connections[0];
+	if (c.state == LINK_IDLE && (currentTimestamp - c.timestamp) <= keepAliveTimeout && currentTimestamp >= c.timestamp) {
+		uint8_t slot = queuePeek();
+		if (slot == REQUEST_NONE) {
+			return;
+		}
+		if (connectionMatches(0, &requests[slot])) {
+			connectionAssign(0, slot);
+			passthroughSend();
+			return;
+		}
+	}
+	// connection broken, idle for too long or needed for another server
+	passthroughEscape();
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::passthroughEscape() {
+	state = STATE_SENDING_DATA;
+	// module takes "+++" for data unless there is silence around it
+	setResponseTrueKeywords();
+	setResponseFalseKeywords();
+	readResponse(ESP8266_ESCAPE_GUARD, &ESP8266Client::PostEscapeGuard);
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::PostEscapeGuard(uint8_t) {
+	// guard time passed, result does not matter
+	state = STATE_SENDING_DATA;
+	serial.print(F("+++"));
+	passthrough = false;
+	readResponse(ESP8266_ESCAPE_GUARD, &ESP8266Client::PostEscape);
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::PostEscape(uint8_t) {
+	// guard time passed, result does not matter
+	state = STATE_SENDING_DATA;
+	// connection stays open in command mode
+	serial.println(F("AT"));
+	setResponseTrueKeywords(KEYWORD_OK);
+	setResponseFalseKeywords(KEYWORD_ERROR);
+	readResponse(2000, &ESP8266Client::PostEscapeProbe);
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::PostEscapeProbe(uint8_t serialResponseStatus) {
+	state = STATE_CONNECTED;
+	if (serialResponseStatus == SERIAL_RESPONSE_TRUE) {
+		attemptCounter = 0;
+		return;
+	}
+	if (attempt(3)) {
+		passthroughEscape();
+	}
+	else {
+		DBG(F("ESP8266 transparent transmission cannot be left \r\n"));
+		hardReset();
+		softReset();
+	}
+}
+
+
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::closeConnection(void)
+{
+	state = STATE_CONNECTED;
+	serial.print(F("AT+CIPCLOSE"));
+	if (multiplexing()) {
+		serial.print(F("="));
+		serial.print(closingLink);
+	}
+	serial.println();
+	setResponseTrueKeywords(KEYWORD_OK, KEYWORD_ERROR);
+	setResponseFalseKeywords();
+	readResponse(10000, &ESP8266Client::PostCloseConnection);
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::PostCloseConnection(uint8_t serialResponseStatus) {
+	state = STATE_CONNECTED;
+	connections[closingLink].state = LINK_FREE;
+	if (serialResponseStatus == SERIAL_RESPONSE_FALSE) {
+		DBG(buffer);
+		DBG(F("\r\nESP8266 socket connection closing error  \r\n"));
+	}
+	else if (serialResponseStatus != SERIAL_RESPONSE_TRUE) {
+		DBG(buffer);
+		DBG(F("\r\nESP8266 socket connection closing  timeout \r\n"));
+	}
+
+}
+
+
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::ipWatchdog(void)
+{
+	if ((currentTimestamp - lastActivityTimestamp) > ESP8266_IP_WATCHDOG_INTERVAL || lastActivityTimestamp == 0 || currentTimestamp < lastActivityTimestamp) {
+		lastActivityTimestamp = currentTimestamp;
+		fetchIP();
+	}
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::runIPCheck() {
+	lastActivityTimestamp = currentTimestamp + ESP8266_IP_WATCHDOG_INTERVAL;
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::fetchIP(void)
+{
+	serial.println(F("AT+CIFSR"));
+
+	setResponseTrueKeywords(KEYWORD_OK);
+	setResponseFalseKeywords(KEYWORD_ERROR);
+	readResponse(10000, &ESP8266Client::PostFetchIP);
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::PostFetchIP(uint8_t serialResponseStatus)
+{
+	char * pch;
+
+	if (serialResponseStatus == SERIAL_RESPONSE_TRUE) {
+		if (strlen(buffer) > 10) {
+			pch = keywordFind(KEYWORD_STAIP);
+			if (pch != NULL) {
+				pch = strtok(pch, "\"");
+				while (pch != NULL)
+				{
+					if ((uint8_t)'0' < (uint8_t)*pch && (1 + (uint8_t)'9') > (uint8_t)*pch) {
+						state = STATE_CONNECTED;
+						if (!isConnected()) {
+							strcpy(ip, pch);
+							DBG(F("ESP8266 IP: "));
+							DBG(ip);
+							DBG(F("\r\n"));
+							// hosts failed maybe only because wifi was down
+							hostsClear();
+							if (wifiConnectedHandler != NULL) {
+								wifiConnectedHandler();
+							}
+						}
+						else {
+							strcpy(ip, pch);
+						}
+						pch = NULL;
+						return;
+					}
+					else {
+						pch = strtok(NULL, "\"");
+					}
+				}
+			}
+		}
+	}
+	DBG(buffer);
+	DBG(F("\r\nESP8266 no IP \r\n"));
+	if (!isConnected() && wifiDisconnectedHandler != NULL) {
+		wifiDisconnectedHandler();
+	}
+	ip[0] = '\0';
+	connected = false;
+	state = STATE_IDLE;
+
+}
+
+
+
+ESP8266_TEMPLATE
+boolean ESP8266_CLIENT::attempt(uint8_t max) {
+	attemptCounter++;
+	if (attemptCounter < max) {
+		/*
+		DBG(F("attempt "));
+		DBG(attemptCounter);
+		DBG(F("\r\n"));
+		*/
+
+		return true;
+	}
+	else {
+		attemptCounter = 0;
+		return false;
+	}
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::readResponse(unsigned long timeout, responseHandler handler) {
+	switch (state) {
+	case STATE_IDLE:
+	case STATE_CONNECTED:
+	case STATE_SENDING_DATA:
+	case STATE_RESETING:
+		state = STATE_RECIVING_DATA;
+		serialResponseTimestamp = currentTimestamp;
+		serialResponseTimeout = timeout;
+		serialResponseHandler = handler;
+		buffer[0] = '\0';
+		bufferCursor = 0; 
+		keywordsReset();
+		//DBG("started listening\r\n");
+		break;
+
+	case STATE_RECIVING_DATA:
+		if ((currentTimestamp - serialResponseTimestamp) > serialResponseTimeout 
+			|| currentTimestamp < serialResponseTimestamp 
+			|| responseMatch != SERIAL_RESPONSE_PENDING
+			|| bufferCursor == (bufferSize - 1)) {
+			state = STATE_DATA_RECIVED;
+			if (responseMatch == SERIAL_RESPONSE_TRUE || bufferCursor == (bufferSize - 1)) {
+				//DBG(F("serial true \r\n"));
+				(this->*handler)(SERIAL_RESPONSE_TRUE);
+			}
+			else if (responseMatch == SERIAL_RESPONSE_FALSE) {
+				//DBG(F("serial false \r\n"));
+				(this->*handler)(SERIAL_RESPONSE_FALSE);
+			}
+			else {
+				//DBG(F("serial timeout \r\n"));
+				(this->*handler)(SERIAL_RESPONSE_TIMEOUT);
+			}
+		}
+		else {
+			rxPoll();
+		}
+		break;
+	}
+
+	lastActivityTimestamp = currentTimestamp;
+	//DBG(state);
+}
+
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::serialFlush() {
+	noInterrupts();
+	while (serial.available() > 0) {
+		serial.read();
+	}
+	rxTail = rxHead;
+	interrupts();
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::keywordsReset() {
+	for (int i = 0; i < KEYWORDS_LIMIT; i++) {
+		responseTrueProgress[i] = 0;
+		responseFalseProgress[i] = 0;
+	}
+	responseMatch = SERIAL_RESPONSE_PENDING;
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::keywordsMatch(char c) {
+	// true keyword wins even if false one was seen earlier in the same response
+	if (responseMatch == SERIAL_RESPONSE_TRUE) {
+		return;
+	}
+	for (int i = 0; i < KEYWORDS_LIMIT; i++) {
+		if (keywordStep(responseTrueKeywords[i], responseTrueProgress[i], c)) {
+			responseMatch = SERIAL_RESPONSE_TRUE;
+			return;
+		}
+		if (responseMatch == SERIAL_RESPONSE_PENDING && keywordStep(responseFalseKeywords[i], responseFalseProgress[i], c)) {
+			responseMatch = SERIAL_RESPONSE_FALSE;
+		}
+	}
+}
+
+ESP8266_TEMPLATE
+boolean ESP8266_CLIENT::keywordStep(uint8_t keyword, uint8_t &progress, char c) {
+	if (keyword == KEYWORD_NONE) {
+		return false;
+	}
+	// on mismatch fall back to the longest keyword prefix which is also suffix
+	// of matched part
+	while (progress > 0 && keywordChar(keyword, progress) != c) {
+		progress = keywordFallback(keyword, progress - 1);
+	}
+	if (keywordChar(keyword, progress) == c) {
+		progress++;
+	}
+	if (keywordChar(keyword, progress) == '\0') {
+		progress = 0;
+		return true;
+	}
+	return false;
+}
+
+ESP8266_TEMPLATE
+uint8_t ESP8266_CLIENT::keywordFallback(uint8_t keyword, uint8_t i) {
+	if (keyword != KEYWORD_CUSTOM) {
+		return pgm_read_byte(&keywordFallbacks[keyword][i]);
+	}
+	// keyword of blocking sendATCommand() has no table, it is computed in place
+	uint8_t fallback = i;
+	while (fallback > 0) {
+		uint8_t j = 0;
+		while (j < fallback && customKeyword[j] == customKeyword[i + 1 - fallback + j]) {
+			j++;
+		}
+		if (j == fallback) {
+			break;
+		}
+		fallback--;
+	}
+	return fallback;
+}
+
+ESP8266_TEMPLATE
+char ESP8266_CLIENT::keywordChar(uint8_t keyword, uint8_t i) {
+	if (keyword == KEYWORD_CUSTOM) {
+		return customKeyword[i];
+	}
+	return pgm_read_byte(&keywordTable[keyword][i]);
+}
+
+ESP8266_TEMPLATE
+char* ESP8266_CLIENT::keywordFind(uint8_t keyword) {
+	return strstr_P(buffer, keywordTable[keyword]);
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::setResponseTrueKeywords(uint8_t k1, uint8_t k2) {
+	responseTrueKeywords[0] = k1;
+	responseTrueKeywords[1] = k2;
+}
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::setResponseFalseKeywords(uint8_t k1, uint8_t k2) {
+	responseFalseKeywords[0] = k1;
+	responseFalseKeywords[1] = k2;
+}
+
+
+
+ESP8266_TEMPLATE
+void ESP8266_CLIENT::update()
+{
+	currentTimestamp = millis();
+
+	// responses and connection closed notifications come whenever they want,
+	// not only while AT command is pending
+	if (state != STATE_RECIVING_DATA) {
+		rxPoll();
+	}
+	if (multiplexing()) {
+		connectionsUpdate();
+	}
+	
+	switch (state) {
+	case STATE_RECIVING_DATA:
+		readResponse(serialResponseTimestamp, serialResponseHandler);
+		break;
+	case STATE_IDLE:
+		if (!connected && autoconnect && ssid != NULL && pwd != NULL) {
+			connectAP(ssid, pwd);
+		}
+		break;
+	case STATE_CONNECTED:
+		dispatchRequest();
+		break;
+
+	}
+	requestsReport();
+	// AT commands would go to server in transparent transmission
+	if (connected && !passthrough) {
+		ipWatchdog();
+	}
+}
+
+ESP8266_TEMPLATE
+char * ESP8266_CLIENT::sendATCommand(char cmd[], char keyword[], unsigned long timeout)
+{
+	serial.flush();
+	serial.print(cmd);
+
+	unsigned long start;
+	start = millis();
+	bufferCursor = 0;
+	buffer[0] = '\0';
+	customKeyword = keyword;
+	setResponseTrueKeywords(KEYWORD_CUSTOM);
+	setResponseFalseKeywords();
+	keywordsReset();
+
+	while (millis() - start < timeout) {
+		noInterrupts();
+		rxEvent();
+		interrupts();
+		while (rxTail != rxHead && bufferCursor < (bufferSize - 1) && responseMatch != SERIAL_RESPONSE_TRUE)
+		{
+			buffer[bufferCursor] = rxRing[rxTail & (ESP8266_RX_RING - 1)];
+			rxTail = rxTail + 1;
+			keywordsMatch(buffer[bufferCursor]);
+			bufferCursor++;
+			buffer[bufferCursor] = '\0';
+		}
+		if (responseMatch == SERIAL_RESPONSE_TRUE)
+		{
+			break;
+		}
+	}
+
+	return buffer;
+}
+
+
+#undef DBG
+#undef DBGL
+#undef DBGW
+#undef DBGBEG
+#undef TRACE
+#undef TRACE_LINK
+#undef ESP8266_TEMPLATE
+#undef ESP8266_CLIENT
+
+#endif
\ No newline at end of file
@@ -0,0 +1,393 @@
+/*
+* Streaming JSON field extractor for Arduino ESP8266 HTTP Client library,
+* see ESP8266Json.h
+*/
+#include "ESP8266Json.h"
+
+// tokenizer states
+#define JSON_EXPECT_VALUE	0
+#define JSON_EXPECT_MEMBER	1 // key or end of object
+#define JSON_EXPECT_COLON	2
+#define JSON_EXPECT_NEXT	3 // comma or end of container
+#define JSON_IN_STRING		4
+#define JSON_IN_ESCAPE		5
+#define JSON_IN_UNICODE		6
+#define JSON_IN_SCALAR		7
+#define JSON_COMPLETE		8
+#define JSON_BROKEN			9
+
+#define JSON_NO_MATCH	0xFF
+
+
+
+ESP8266Json::ESP8266Json()
+{
+	paths = NULL;
+	pathCount = 0;
+	valueHandler = NULL;
+	begin();
+}
+
+void ESP8266Json::setPaths(const char * const _paths[], uint8_t count) {
+	paths = _paths;
+	pathCount = count < ESP8266_JSON_PATHS ? count : ESP8266_JSON_PATHS;
+}
+
+void ESP8266Json::setOnValue(void(*handler)(uint8_t path, const char value[], uint8_t type)) {
+	valueHandler = handler;
+}
+
+void ESP8266Json::begin() {
+	state = JSON_EXPECT_VALUE;
+	depth = 0;
+	arrays = 0;
+	inKey = false;
+	capture = false;
+	valueLength = 0;
+	value[0] = '\0';
+	for (uint8_t p = 0; p < ESP8266_JSON_PATHS; p++) {
+		matched[p] = 0;
+		keyProgress[p] = JSON_NO_MATCH;
+	}
+}
+
+void ESP8266Json::feed(const char data[], size_t length) {
+	for (size_t i = 0; i < length; i++) {
+		step(data[i]);
+	}
+}
+
+void ESP8266Json::feed(char c) {
+	step(c);
+}
+
+boolean ESP8266Json::end() {
+	if (state == JSON_IN_SCALAR && depth == 0) {
+		// number or literal as whole document ends with it
+		emit();
+		state = JSON_COMPLETE;
+	}
+	return state == JSON_COMPLETE;
+}
+
+
+
+void ESP8266Json::step(char c) {
+	switch (state) {
+	case JSON_IN_STRING:
+		if (c == '"') {
+			if (inKey) {
+				keyEnd();
+				state = JSON_EXPECT_COLON;
+			}
+			else {
+				emit();
+				state = JSON_EXPECT_NEXT;
+			}
+		}
+		else if (c == '\\') {
+			state = JSON_IN_ESCAPE;
+		}
+		else {
+			stringChar(c);
+		}
+		return;
+
+	case JSON_IN_ESCAPE:
+		state = JSON_IN_STRING;
+		switch (c) {
+		case 'b': stringChar('\b'); break;
+		case 'f': stringChar('\f'); break;
+		case 'n': stringChar('\n'); break;
+		case 'r': stringChar('\r'); break;
+		case 't': stringChar('\t'); break;
+		case 'u':
+			unicode = 0;
+			unicodeLeft = 4;
+			state = JSON_IN_UNICODE;
+			break;
+		default: stringChar(c); break;
+		}
+		return;
+
+	case JSON_IN_UNICODE:
+		if (c >= '0' && c <= '9') {
+			unicode = unicode * 16 + (c - '0');
+		}
+		else if ((c | 0x20) >= 'a' && (c | 0x20) <= 'f') {
+			unicode = unicode * 16 + ((c | 0x20) - 'a' + 10);
+		}
+		else {
+			state = JSON_BROKEN;
+			return;
+		}
+		unicodeLeft--;
+		if (unicodeLeft == 0) {
+			unicodeChar(unicode);
+			state = JSON_IN_STRING;
+		}
+		return;
+
+	case JSON_IN_SCALAR:
+		if ((c >= '0' && c <= '9') || ((c | 0x20) >= 'a' && (c | 0x20) <= 'z') || c == '.' || c == '-' || c == '+') {
+			stringChar(c);
+			return;
+		}
+		// character after number is handled as any other
+		emit();
+		state = depth == 0 ? JSON_COMPLETE : JSON_EXPECT_NEXT;
+		break;
+
+	case JSON_BROKEN:
+		return;
+	}
+
+	if (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+		return;
+	}
+	boolean array = depth > 0 && (arrays & (1 << (depth - 1)));
+
+	switch (state) {
+	case JSON_EXPECT_VALUE:
+		if (c == ']' && array) {
+			// empty array
+			pop();
+			return;
+		}
+		if (array) {
+			elementStart();
+		}
+		if (!valueStart(c)) {
+			state = JSON_BROKEN;
+		}
+		break;
+
+	case JSON_EXPECT_MEMBER:
+		if (c == '"') {
+			keyStart();
+			inKey = true;
+			state = JSON_IN_STRING;
+		}
+		else if (c == '}') {
+			pop();
+		}
+		else {
+			state = JSON_BROKEN;
+		}
+		break;
+
+	case JSON_EXPECT_COLON:
+		state = c == ':' ? JSON_EXPECT_VALUE : JSON_BROKEN;
+		break;
+
+	case JSON_EXPECT_NEXT:
+		if (c == ',' && depth > 0) {
+			if (array) {
+				if (index[depth - 1] < 0xFF) {
+					index[depth - 1]++;
+				}
+				state = JSON_EXPECT_VALUE;
+			}
+			else {
+				state = JSON_EXPECT_MEMBER;
+			}
+		}
+		else if ((c == ']' && array) || (c == '}' && depth > 0 && !array)) {
+			pop();
+		}
+		else {
+			state = JSON_BROKEN;
+		}
+		break;
+
+	default:
+		// anything after complete document
+		state = JSON_BROKEN;
+		break;
+	}
+}
+
+boolean ESP8266Json::valueStart(char c) {
+	capture = wanted();
+	valueLength = 0;
+	value[0] = '\0';
+	inKey = false;
+
+	if (c == '{' || c == '[') {
+		push(c == '[');
+	}
+	else if (c == '"') {
+		valueType = JSON_STRING;
+		state = JSON_IN_STRING;
+	}
+	else if (c == '-' || (c >= '0' && c <= '9')) {
+		valueType = JSON_NUMBER;
+		state = JSON_IN_SCALAR;
+		stringChar(c);
+	}
+	else if (c == 't' || c == 'f' || c == 'n') {
+		valueType = JSON_LITERAL;
+		state = JSON_IN_SCALAR;
+		stringChar(c);
+	}
+	else {
+		return false;
+	}
+	return true;
+}
+
+void ESP8266Json::push(boolean array) {
+	if (depth == ESP8266_JSON_DEPTH) {
+		state = JSON_BROKEN;
+		return;
+	}
+	if (array) {
+		arrays |= 1 << depth;
+	}
+	else {
+		arrays &= ~(1 << depth);
+	}
+	index[depth] = 0;
+	depth++;
+	state = array ? JSON_EXPECT_VALUE : JSON_EXPECT_MEMBER;
+}
+
+void ESP8266Json::pop() {
+	depth--;
+	// location is back at member (element) holding closed container
+	for (uint8_t p = 0; p < pathCount; p++) {
+		if (matched[p] > depth) {
+			matched[p] = depth;
+		}
+	}
+	state = depth == 0 ? JSON_COMPLETE : JSON_EXPECT_NEXT;
+}
+
+void ESP8266Json::stringChar(char c) {
+	if (inKey) {
+		// key is compared with paths as it comes, never stored
+		for (uint8_t p = 0; p < pathCount; p++) {
+			if (keyProgress[p] != JSON_NO_MATCH) {
+				keyProgress[p] = paths[p][keyProgress[p]] == c ? keyProgress[p] + 1 : JSON_NO_MATCH;
+			}
+		}
+	}
+	else if (capture && valueLength < ESP8266_JSON_VALUE - 1) {
+		value[valueLength] = c;
+		valueLength++;
+		value[valueLength] = '\0';
+	}
+}
+
+void ESP8266Json::unicodeChar(uint16_t code) {
+	// UTF-8
+	if (code < 0x80) {
+		stringChar(code);
+	}
+	else if (code < 0x800) {
+		stringChar(0xC0 | (code >> 6));
+		stringChar(0x80 | (code & 0x3F));
+	}
+	else {
+		stringChar(0xE0 | (code >> 12));
+		stringChar(0x80 | ((code >> 6) & 0x3F));
+		stringChar(0x80 | (code & 0x3F));
+	}
+}
+
+void ESP8266Json::keyStart() {
+	for (uint8_t p = 0; p < pathCount; p++) {
+		keyProgress[p] = JSON_NO_MATCH;
+		if (matched[p] >= depth - 1) {
+			uint8_t o = segment(paths[p], depth);
+			if (paths[p][o] != '[' && paths[p][o] != '\0') {
+				keyProgress[p] = o;
+			}
+		}
+	}
+}
+
+void ESP8266Json::keyEnd() {
+	for (uint8_t p = 0; p < pathCount; p++) {
+		if (matched[p] < depth - 1) {
+			continue;
+		}
+		// whole path segment was compared
+		char next = keyProgress[p] != JSON_NO_MATCH ? paths[p][keyProgress[p]] : 'x';
+		matched[p] = (next == '.' || next == '[' || next == '\0') ? depth : depth - 1;
+	}
+}
+
+void ESP8266Json::elementStart() {
+	for (uint8_t p = 0; p < pathCount; p++) {
+		if (matched[p] < depth - 1) {
+			continue;
+		}
+		const char *s = paths[p] + segment(paths[p], depth);
+		boolean match = false;
+		if (s[0] == '[') {
+			if (s[1] == '*') {
+				match = true;
+			}
+			else {
+				uint16_t i = 0;
+				for (s++; *s >= '0' && *s <= '9'; s++) {
+					i = i * 10 + (*s - '0');
+				}
+				match = *s == ']' && i == index[depth - 1];
+			}
+		}
+		matched[p] = match ? depth : depth - 1;
+	}
+}
+
+boolean ESP8266Json::wanted() {
+	for (uint8_t p = 0; p < pathCount; p++) {
+		if (depth > 0 && matched[p] == depth && segments(paths[p]) == depth) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void ESP8266Json::emit() {
+	if (!capture || valueHandler == NULL) {
+		return;
+	}
+	for (uint8_t p = 0; p < pathCount; p++) {
+		if (matched[p] == depth && segments(paths[p]) == depth) {
+			valueHandler(p, value, valueType);
+		}
+	}
+}
+
+uint8_t ESP8266Json::segment(const char path[], uint8_t n) {
+	uint8_t o = 0;
+	for (uint8_t k = 1; k < n && path[o] != '\0'; k++) {
+		if (path[o] == '[') {
+			while (path[o] != '\0' && path[o] != ']') {
+				o++;
+			}
+			if (path[o] == ']') {
+				o++;
+			}
+		}
+		else {
+			while (path[o] != '\0' && path[o] != '.' && path[o] != '[') {
+				o++;
+			}
+		}
+		if (path[o] == '.') {
+			o++;
+		}
+	}
+	return o;
+}
+
+uint8_t ESP8266Json::segments(const char path[]) {
+	uint8_t n = 0;
+	while (path[segment(path, n + 1)] != '\0') {
+		n++;
+	}
+	return n;
+}
@@ -0,0 +1,97 @@
+/*
+* Streaming JSON field extractor for Arduino ESP8266 HTTP Client library
+*
+* Response body is fed byte by byte as it comes from ESP8266 and scalar values
+* found under registered paths are passed to handler. Document is never kept
+* in memory, only tokenizer state of constant size (nesting stack, match
+* progress of each path and one value).
+*
+* Paths are dot separated keys with array indexes, "*" matches any index:
+*
+*	"data.temp"  "cmd[0].id"  "list[*].name"  "[2]"
+*
+* Used by ESP8266::setJsonExtractor(), or standalone with begin()/feed()/end().
+*/
+
+#ifndef __ESP8266_JSON_H__
+#define __ESP8266_JSON_H__
+
+#if defined(ARDUINO) && ARDUINO >= 100
+	#include "Arduino.h"
+#else
+	#include "WProgram.h"
+#endif
+
+// max number of registered paths
+#define ESP8266_JSON_PATHS 4
+// max nesting of objects and arrays, deeper documents stop extraction
+#define ESP8266_JSON_DEPTH 8
+// value buffer, longer values are truncated
+#define ESP8266_JSON_VALUE 24
+
+// value types passed to handler
+#define JSON_STRING		0 // unescaped, without quotes
+#define JSON_NUMBER		1 // as written in document
+#define JSON_LITERAL	2 // true, false or null
+
+class ESP8266Json
+{
+  public:
+	ESP8266Json();
+
+	// paths to extract (max ESP8266_JSON_PATHS), array and strings are not copied
+	void setPaths(const char * const paths[], uint8_t count);
+
+	// set handler invoked with index of matched path, value and its type
+	void setOnValue(void(*handler)(uint8_t path, const char value[], uint8_t type));
+
+	// start new document
+	void begin();
+	void feed(char c);
+	void feed(const char data[], size_t length);
+	// end of document, returns true when it was complete and well formed
+	boolean end();
+
+  protected:
+	const char * const *paths;
+	uint8_t pathCount;
+	void(*valueHandler)(uint8_t path, const char value[], uint8_t type);
+
+	// tokenizer
+	uint8_t state;
+	uint8_t depth;
+	uint8_t arrays; // bit per nesting level, set for array
+	uint8_t index[ESP8266_JSON_DEPTH]; // element of array being parsed
+	boolean inKey;
+	uint8_t unicodeLeft;
+	uint16_t unicode;
+
+	// per path: leading path segments matching current location, position in path of
+	// key being compared (0xFF when it does not match)
+	uint8_t matched[ESP8266_JSON_PATHS];
+	uint8_t keyProgress[ESP8266_JSON_PATHS];
+
+	// value of wanted path
+	boolean capture;
+	uint8_t valueType;
+	char value[ESP8266_JSON_VALUE];
+	uint8_t valueLength;
+
+	void step(char c);
+	boolean valueStart(char c);
+	void push(boolean array);
+	void pop();
+	void stringChar(char c);
+	void unicodeChar(uint16_t code);
+	void keyStart();
+	void keyEnd();
+	void elementStart();
+	void emit();
+	boolean wanted();
+
+	// offset of segment (1 based) in path, segments count
+	uint8_t segment(const char path[], uint8_t n);
+	uint8_t segments(const char path[]);
+};
+
+#endif
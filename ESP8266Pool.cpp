@@ -0,0 +1,11 @@
+/*
+* Dispatcher spreading requests over several ESP8266 modules, see ESP8266Pool.h
+*
+* ESP8266ClientPool template lives in ESP8266Pool.h and ESP8266PoolImpl.h, pool
+* of default clients (ESP8266Pool) is compiled here once.
+*/
+#include "ESP8266Pool.h"
+
+
+
+template class ESP8266ClientPool<>;
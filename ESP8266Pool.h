@@ -0,0 +1,92 @@
+/*
+* Dispatcher spreading requests over several ESP8266 modules, for Arduino
+* ESP8266 HTTP Client library
+*
+* Every module is its own client instance (serial port, RST pin, queue and
+* links), set up and given handlers as usual. Pool updates all of them and
+* sends each new request through connected module with fewest pending
+* requests, so modules share the load and requests keep going out while one
+* of them is without wifi or being reset. Requests waiting in queue of module
+* without wifi are moved to connected one, they keep their ids, so give all
+* modules the same handlers. Requests already sent stay with their module.
+*
+*	ESP8266 wifi1(Serial1, 16), wifi2(Serial2, 17);
+*	ESP8266Pool pool;
+*	pool.add(wifi1);
+*	pool.add(wifi2);
+*
+* Pool of other client type (ESP8266Client with other sizes or features):
+*
+*	ESP8266ClientPool<ESP8266Client<HardwareSerial, 256, 3> > pool;
+*/
+
+#ifndef __ESP8266_POOL_H__
+#define __ESP8266_POOL_H__
+
+#include "ESP8266.h"
+
+// max number of modules in pool
+#define ESP8266_POOL_MAX 4
+
+#define MODULE_NONE 0xFF
+
+template <class ClientT = ESP8266>
+class ESP8266ClientPool
+{
+  public:
+	ESP8266ClientPool();
+
+	// add module, returns false when pool is full
+	boolean add(ClientT &module);
+	ClientT& module(uint8_t index);
+	uint8_t getModuleCount();
+	// modules connected to wifi
+	uint8_t getReadyCount();
+
+	// update all modules and move requests waiting in modules without wifi to connected
+	// ones, call as often as you can
+	void update();
+
+	// same as ESP8266 ones, request goes to connected module with fewest pending requests
+	// (next one is tried when its queue is full), when no module is connected it waits in
+	// queue of one of them until some module connects
+	boolean sendHttpRequest(char serverIP[], uint16_t port, char method[], char url[], char postData[] = NULL, char queryData[] = NULL,
+		uint8_t priority = PRIORITY_NORMAL, unsigned long deadline = 0);
+	boolean sendHttpRequest_P(char serverIP[], uint16_t port, char method[], char url[], const __FlashStringHelper *postData,
+		char queryData[] = NULL, uint8_t priority = PRIORITY_NORMAL, unsigned long deadline = 0);
+	boolean sendHttpRequestFrom(char serverIP[], uint16_t port, char method[], char url[], size_t bodyLength,
+		size_t(*producer)(char data[], size_t offset, size_t size), char queryData[] = NULL,
+		uint8_t priority = PRIORITY_NORMAL, unsigned long deadline = 0);
+
+	// id of last request accepted, unique across modules of pool, getResponseRequestId()
+	// of module tells it in handlers
+	uint8_t getLastRequestId();
+	// module which accepted last request (request may be moved to other one later)
+	uint8_t getLastModule();
+	// module being updated, valid in handlers (they are invoked from update())
+	uint8_t getCurrentModule();
+
+  protected:
+	ClientT *modules[ESP8266_POOL_MAX];
+	uint8_t moduleCount;
+	uint8_t lastModule;
+	uint8_t currentModule;
+	uint8_t requestCounter;
+
+	// modules in order requests are offered to them, returns their count
+	uint8_t rank(uint8_t order[]);
+	// lower is better, ties go round robin after last used module
+	uint16_t load(uint8_t index);
+	// new request id and modules in order request is offered to them, returns their count
+	uint8_t prepare(uint8_t order[]);
+	// requests waiting in modules without wifi go to connected ones
+	void rebalance();
+};
+
+#include "ESP8266PoolImpl.h"
+
+typedef ESP8266ClientPool<> ESP8266Pool;
+// compiled once in ESP8266Pool.cpp
+extern template class ESP8266ClientPool<>;
+
+#endif
@@ -0,0 +1,187 @@
+/*
+* Dispatcher spreading requests over several ESP8266 modules, see ESP8266Pool.h
+*/
+
+#define ESP8266_POOL_TEMPLATE template <class ClientT>
+#define ESP8266_POOL ESP8266ClientPool<ClientT>
+
+
+
+ESP8266_POOL_TEMPLATE
+ESP8266_POOL::ESP8266ClientPool()
+{
+	moduleCount = 0;
+	lastModule = MODULE_NONE;
+	currentModule = MODULE_NONE;
+	requestCounter = 0;
+}
+
+ESP8266_POOL_TEMPLATE
+boolean ESP8266_POOL::add(ClientT &module) {
+	if (moduleCount == ESP8266_POOL_MAX) {
+		return false;
+	}
+	modules[moduleCount] = &module;
+	moduleCount++;
+	return true;
+}
+
+ESP8266_POOL_TEMPLATE
+ClientT& ESP8266_POOL::module(uint8_t index) {
+	return *modules[index];
+}
+
+ESP8266_POOL_TEMPLATE
+uint8_t ESP8266_POOL::getModuleCount() {
+	return moduleCount;
+}
+
+ESP8266_POOL_TEMPLATE
+uint8_t ESP8266_POOL::getReadyCount() {
+	uint8_t ready = 0;
+	for (uint8_t i = 0; i < moduleCount; i++) {
+		if (modules[i]->isConnected()) {
+			ready++;
+		}
+	}
+	return ready;
+}
+
+ESP8266_POOL_TEMPLATE
+void ESP8266_POOL::update() {
+	for (uint8_t i = 0; i < moduleCount; i++) {
+		currentModule = i;
+		modules[i]->update();
+	}
+	currentModule = MODULE_NONE;
+	rebalance();
+}
+
+
+
+ESP8266_POOL_TEMPLATE
+boolean ESP8266_POOL::sendHttpRequest(char serverIP[], uint16_t port, char method[], char url[], char postData[], char queryData[],
+	uint8_t priority, unsigned long deadline) {
+	uint8_t order[ESP8266_POOL_MAX];
+	uint8_t n = prepare(order);
+	for (uint8_t i = 0; i < n; i++) {
+		modules[order[i]]->setNextRequestId(requestCounter);
+		if (modules[order[i]]->sendHttpRequest(serverIP, port, method, url, postData, queryData, priority, deadline)) {
+			lastModule = order[i];
+			return true;
+		}
+	}
+	return false;
+}
+
+ESP8266_POOL_TEMPLATE
+boolean ESP8266_POOL::sendHttpRequest_P(char serverIP[], uint16_t port, char method[], char url[], const __FlashStringHelper *postData,
+	char queryData[], uint8_t priority, unsigned long deadline) {
+	uint8_t order[ESP8266_POOL_MAX];
+	uint8_t n = prepare(order);
+	for (uint8_t i = 0; i < n; i++) {
+		modules[order[i]]->setNextRequestId(requestCounter);
+		if (modules[order[i]]->sendHttpRequest_P(serverIP, port, method, url, postData, queryData, priority, deadline)) {
+			lastModule = order[i];
+			return true;
+		}
+	}
+	return false;
+}
+
+ESP8266_POOL_TEMPLATE
+boolean ESP8266_POOL::sendHttpRequestFrom(char serverIP[], uint16_t port, char method[], char url[], size_t bodyLength,
+	size_t(*producer)(char data[], size_t offset, size_t size), char queryData[], uint8_t priority, unsigned long deadline) {
+	uint8_t order[ESP8266_POOL_MAX];
+	uint8_t n = prepare(order);
+	for (uint8_t i = 0; i < n; i++) {
+		modules[order[i]]->setNextRequestId(requestCounter);
+		if (modules[order[i]]->sendHttpRequestFrom(serverIP, port, method, url, bodyLength, producer, queryData, priority, deadline)) {
+			lastModule = order[i];
+			return true;
+		}
+	}
+	return false;
+}
+
+ESP8266_POOL_TEMPLATE
+uint8_t ESP8266_POOL::getLastRequestId() {
+	return requestCounter;
+}
+
+ESP8266_POOL_TEMPLATE
+uint8_t ESP8266_POOL::getLastModule() {
+	return lastModule;
+}
+
+ESP8266_POOL_TEMPLATE
+uint8_t ESP8266_POOL::getCurrentModule() {
+	return currentModule;
+}
+
+
+
+ESP8266_POOL_TEMPLATE
+uint8_t ESP8266_POOL::rank(uint8_t order[]) {
+	// while some module is connected, requests do not wait for the others
+	boolean ready = getReadyCount() > 0;
+	uint8_t n = 0;
+	// insertion sort, pool is tiny
+	for (uint8_t i = 0; i < moduleCount; i++) {
+		if (ready && !modules[i]->isConnected()) {
+			continue;
+		}
+		uint8_t j = n;
+		n++;
+		while (j > 0 && load(order[j - 1]) > load(i)) {
+			order[j] = order[j - 1];
+			j--;
+		}
+		order[j] = i;
+	}
+	return n;
+}
+
+ESP8266_POOL_TEMPLATE
+uint16_t ESP8266_POOL::load(uint8_t index) {
+	uint16_t l = (uint16_t)modules[index]->getPendingRequests() * ESP8266_POOL_MAX;
+	// distance after last used module
+	uint8_t start = lastModule == MODULE_NONE ? 0 : (lastModule + 1) % moduleCount;
+	return l + (index + moduleCount - start) % moduleCount;
+}
+
+ESP8266_POOL_TEMPLATE
+uint8_t ESP8266_POOL::prepare(uint8_t order[]) {
+	// modules count ids of pool, so request keeps its id when it is moved
+	requestCounter++;
+	if (requestCounter == 0) {
+		requestCounter = 1;
+	}
+	return rank(order);
+}
+
+ESP8266_POOL_TEMPLATE
+void ESP8266_POOL::rebalance() {
+	if (getReadyCount() == 0) {
+		return;
+	}
+	ESP8266Request r;
+	for (uint8_t i = 0; i < moduleCount; i++) {
+		if (modules[i]->isConnected()) {
+			continue;
+		}
+		while (modules[i]->takeRequest(r)) {
+			uint8_t order[ESP8266_POOL_MAX];
+			uint8_t n = rank(order);
+			uint8_t j = 0;
+			while (j < n && !modules[order[j]]->putRequest(r)) {
+				j++;
+			}
+			if (j == n) {
+				// connected modules are full, request waits where it was
+				modules[i]->putRequest(r);
+				return;
+			}
+		}
+	}
+}
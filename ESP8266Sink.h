@@ -0,0 +1,60 @@
+/*
+* Block storage sink for Arduino ESP8266 HTTP Client library
+*
+* Response bodies too big for internal buffer are spilled to storage (SD card,
+* SPI flash, EEPROM, file on the host build) instead of being thrown away.
+* Body is written in blocks of ESP8266_SINK_BLOCK bytes (less when link part
+* of internal buffer is smaller), only the last one is shorter. When write()
+* refuses block (storage busy), library stops reading module output and offers
+* the same block again on next update(), incoming bytes meanwhile wait in
+* receive ring and serial port. Last block is offered the same way for up to
+* ESP8266_SINK_TIMEOUT, then body is closed incomplete.
+*
+* Implement it for your storage and give it to ESP8266::setSink():
+*
+*	class EepromSink : public ESP8266Sink {
+*		uint16_t open(uint8_t requestId, uint32_t length) { return length <= EEPROM.length() ? 0 : SINK_NONE; }
+*		boolean write(uint32_t offset, const uint8_t data[], uint16_t length) { ... return true; }
+*		void close(boolean complete) {}
+*	};
+*/
+
+#ifndef __ESP8266_SINK_H__
+#define __ESP8266_SINK_H__
+
+#if defined(ARDUINO) && ARDUINO >= 100
+	#include "Arduino.h"
+#else
+	#include "WProgram.h"
+#endif
+
+// size of blocks passed to write(), they are collected in internal buffer
+#ifndef ESP8266_SINK_BLOCK
+	#define ESP8266_SINK_BLOCK 64
+#endif
+// how long last block of body is offered to busy storage before body is given up, ms
+#ifndef ESP8266_SINK_TIMEOUT
+	#define ESP8266_SINK_TIMEOUT 1000
+#endif
+
+// open() refused body
+#define SINK_NONE 0xFFFF
+
+class ESP8266Sink
+{
+  public:
+	virtual ~ESP8266Sink() {}
+
+	// new body starts, length is Content-Length or HTTP_LENGTH_UNKNOWN. Returns handle
+	// passed to stored handler (file number, first sector...), SINK_NONE refuses body,
+	// it goes to internal buffer then as without sink
+	virtual uint16_t open(uint8_t requestId, uint32_t length) = 0;
+
+	// store block of body at offset, false when storage is busy
+	virtual boolean write(uint32_t offset, const uint8_t data[], uint16_t length) = 0;
+
+	// last block was written, complete is false when body was cut off
+	virtual void close(boolean complete) = 0;
+};
+
+#endif
@@ -0,0 +1,97 @@
+/*
+* Transport for Arduino ESP8266 HTTP Client library
+*
+* Client talks to module over any port given as its SerialT (HardwareSerial by
+* default). Ports which are not serial-like (buffered DMA UART driver, pty or
+* socketpair on the host for load testing) implement ESP8266Transport, bytes
+* go through it in blocks instead of one read() call per byte:
+*
+*	class DmaTransport : public ESP8266Transport {
+*		int available() { ... }
+*		size_t read(uint8_t data[], size_t size) { ... }
+*		size_t write(const uint8_t data[], size_t size) { ... }
+*	};
+*	DmaTransport dma;
+*	ESP8266Client<ESP8266Transport> wifi(dma, 16);
+*
+* ESP8266SerialTransport wraps existing port (SoftwareSerial, Serial2...), so
+* one client type can run over ports chosen at runtime.
+*/
+
+#ifndef __ESP8266_TRANSPORT_H__
+#define __ESP8266_TRANSPORT_H__
+
+#if defined(ARDUINO) && ARDUINO >= 100
+	#include "Arduino.h"
+#else
+	#include "WProgram.h"
+#endif
+
+class ESP8266Transport : public Stream
+{
+  public:
+	virtual ~ESP8266Transport() {}
+
+	// called after reset and baud rate change, transports without baud rate ignore it
+	virtual void begin(unsigned long) {}
+
+	// bytes recived and not read yet
+	virtual int available() = 0;
+
+	// moves up to size recived bytes to data, never waits, returns their number
+	virtual size_t read(uint8_t data[], size_t size) = 0;
+
+	// sends size bytes of data, returns number of bytes taken
+	virtual size_t write(const uint8_t data[], size_t size) = 0;
+
+	// single bytes go through block ones, peek() is not used by client
+	int read() {
+		uint8_t c;
+		return read(&c, 1) == 1 ? c : -1;
+	}
+	int peek() { return -1; }
+	size_t write(uint8_t c) { return write(&c, 1); }
+	using Print::write;
+};
+
+// any serial-like port (begin(), available(), read(), write()) as transport
+template <class SerialT>
+class ESP8266SerialTransport : public ESP8266Transport
+{
+  public:
+	ESP8266SerialTransport(SerialT &_port) : port(_port) {}
+
+	void begin(unsigned long baud) { port.begin(baud); }
+	int available() { return port.available(); }
+	size_t read(uint8_t data[], size_t size) {
+		size_t n = 0;
+		while (n < size && port.available() > 0) {
+			data[n] = port.read();
+			n++;
+		}
+		return n;
+	}
+	size_t write(const uint8_t data[], size_t size) { return port.write(data, size); }
+	void flush() { port.flush(); }
+	using ESP8266Transport::read;
+	using ESP8266Transport::write;
+
+  protected:
+	SerialT &port;
+};
+
+// block read from port of client, transports do it in one call, other ports byte by byte
+inline size_t esp8266Read(ESP8266Transport *port, uint8_t data[], size_t size) {
+	return port->read(data, size);
+}
+
+inline size_t esp8266Read(Stream *port, uint8_t data[], size_t size) {
+	size_t n = 0;
+	while (n < size && port->available() > 0) {
+		data[n] = port->read();
+		n++;
+	}
+	return n;
+}
+
+#endif
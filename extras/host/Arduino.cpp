@@ -0,0 +1,306 @@
+/*
+* Host (Linux) shim of the Arduino core, see Arduino.h
+*/
+
+#include "Arduino.h"
+
+static uint64_t clockMicros = 0;
+static uint32_t pollCost = 20;
+static uint32_t readCost = 0;
+static void (*timerIsr)(void) = NULL;
+static uint32_t timerPeriod = 0;
+static uint64_t timerNext = 0;
+static bool interruptsEnabled = true;
+
+FILE *hostDebugOut = stderr;
+
+uint64_t hostMicros(void)
+{
+	return clockMicros;
+}
+
+void hostAdvance(uint64_t us)
+{
+	clockMicros += us;
+}
+
+void hostSetPollCost(uint32_t us)
+{
+	pollCost = us;
+}
+
+void hostSetReadCost(uint32_t us)
+{
+	readCost = us;
+}
+
+static void timerPoll(void);
+
+unsigned long millis(void)
+{
+	clockMicros += pollCost;
+	timerPoll();
+	return (unsigned long)(clockMicros / 1000);
+}
+
+unsigned long micros(void)
+{
+	clockMicros += pollCost;
+	timerPoll();
+	return (unsigned long)clockMicros;
+}
+
+void hostTimerInterrupt(void (*isr)(void), uint32_t periodUs)
+{
+	timerIsr = isr;
+	timerPeriod = periodUs;
+	timerNext = clockMicros + periodUs;
+}
+
+// run timer interrupt if it is due and interrupts are enabled, ticks missed meanwhile
+// make one pending interrupt, like flag of AVR timer
+static void timerPoll(void)
+{
+	if (timerIsr == NULL || !interruptsEnabled || timerNext > clockMicros) {
+		return;
+	}
+	while (timerNext <= clockMicros) {
+		timerNext += timerPeriod;
+	}
+	// isr runs with interrupts disabled, it never interrupts itself
+	interruptsEnabled = false;
+	timerIsr();
+	interruptsEnabled = true;
+}
+
+void noInterrupts(void)
+{
+	interruptsEnabled = false;
+}
+
+void interrupts(void)
+{
+	interruptsEnabled = true;
+	timerPoll();
+}
+
+// pass time, running timer interrupt when it is due
+static void sleepUntil(uint64_t until)
+{
+	timerPoll();
+	while (timerIsr != NULL && interruptsEnabled && timerNext <= until) {
+		clockMicros = timerNext;
+		timerPoll();
+	}
+	if (clockMicros < until) {
+		clockMicros = until;
+	}
+}
+
+void delay(unsigned long ms)
+{
+	sleepUntil(clockMicros + (uint64_t)ms * 1000);
+}
+
+void delayMicroseconds(unsigned int us)
+{
+	sleepUntil(clockMicros + us);
+}
+
+void pinMode(uint8_t, uint8_t) {}
+
+static uint8_t pins[64];
+static HostPinHandler pinHandlers[HOST_PIN_LISTENERS];
+static void *pinContexts[HOST_PIN_LISTENERS];
+static uint8_t pinListeners = 0;
+
+void hostOnPin(HostPinHandler handler, void *context)
+{
+	if (pinListeners < HOST_PIN_LISTENERS) {
+		pinHandlers[pinListeners] = handler;
+		pinContexts[pinListeners] = context;
+		pinListeners++;
+	}
+}
+
+void digitalWrite(uint8_t pin, uint8_t val)
+{
+	if (pin < sizeof(pins)) {
+		pins[pin] = val;
+	}
+	for (uint8_t i = 0; i < pinListeners; i++) {
+		pinHandlers[i](pin, val, pinContexts[i]);
+	}
+}
+
+int digitalRead(uint8_t pin)
+{
+	return pin < sizeof(pins) ? pins[pin] : LOW;
+}
+
+static uint32_t randomState = 1;
+
+void randomSeed(unsigned long seed)
+{
+	randomState = seed != 0 ? (uint32_t)seed : 1;
+}
+
+long random(long max)
+{
+	// xorshift32, same sequence on every host
+	randomState ^= randomState << 13;
+	randomState ^= randomState >> 17;
+	randomState ^= randomState << 5;
+	return max > 0 ? (long)(randomState % (uint32_t)max) : 0;
+}
+
+long random(long min, long max)
+{
+	return max > min ? min + random(max - min) : min;
+}
+
+
+
+size_t Print::write(const uint8_t *buffer, size_t size)
+{
+	size_t n = 0;
+	while (size--) {
+		n += write(*buffer++);
+	}
+	return n;
+}
+
+size_t Print::print(long n, int base)
+{
+	if (n < 0 && base == DEC) {
+		size_t t = write('-');
+		return t + print((unsigned long)-n, base);
+	}
+	return print((unsigned long)n, base);
+}
+
+size_t Print::print(unsigned long n, int base)
+{
+	char buf[8 * sizeof(long) + 1];
+	char *str = &buf[sizeof(buf) - 1];
+	*str = '\0';
+	if (base < 2) {
+		base = 10;
+	}
+	do {
+		char c = n % base;
+		n /= base;
+		*--str = c < 10 ? c + '0' : c + 'A' - 10;
+	} while (n);
+	return write(str);
+}
+
+size_t Print::print(double n, int digits)
+{
+	char buf[48];
+	snprintf(buf, sizeof(buf), "%.*f", digits, n);
+	return write(buf);
+}
+
+
+
+HardwareSerial::HardwareSerial()
+	: peer(NULL), baud(9600), rxHead(0), rxCount(0), txFree(0), rxOverruns(0), rxBytes(0), txBytes(0)
+{
+}
+
+void HardwareSerial::begin(unsigned long _baud)
+{
+	// whatever arrived before (re)initialization is lost, like on real UART
+	if (peer != NULL) {
+		peer->hostPoll(hostMicros());
+	}
+	baud = _baud;
+	rxHead = 0;
+	rxCount = 0;
+	if (peer != NULL) {
+		peer->hostBaud(baud);
+	}
+}
+
+void HardwareSerial::poll()
+{
+	if (peer != NULL) {
+		peer->hostPoll(hostMicros());
+	}
+	timerPoll();
+}
+
+bool HardwareSerial::deliver(uint8_t c)
+{
+	if (rxCount >= SERIAL_RX_FIFO_SIZE) {
+		rxOverruns++;
+		return false;
+	}
+	rxFifo[(rxHead + rxCount) % SERIAL_RX_FIFO_SIZE] = c;
+	rxCount++;
+	return true;
+}
+
+int HardwareSerial::available()
+{
+	poll();
+	return rxCount;
+}
+
+int HardwareSerial::peek()
+{
+	poll();
+	return rxCount > 0 ? rxFifo[rxHead] : -1;
+}
+
+int HardwareSerial::read()
+{
+	clockMicros += readCost;
+	poll();
+	if (rxCount == 0) {
+		return -1;
+	}
+	uint8_t c = rxFifo[rxHead];
+	rxHead = (rxHead + 1) % SERIAL_RX_FIFO_SIZE;
+	rxCount--;
+	rxBytes++;
+	return c;
+}
+
+size_t HardwareSerial::write(uint8_t c)
+{
+	uint64_t now = hostMicros();
+	if (peer == NULL) {
+		if (hostDebugOut != NULL) {
+			fputc(c, hostDebugOut);
+		}
+		return 1;
+	}
+	if (txFree < now) {
+		txFree = now;
+	}
+	// the TX FIFO is full, block until the shifter makes room like the AVR core does
+	uint64_t backlog = SERIAL_TX_FIFO_SIZE * byteTime();
+	if (txFree - now > backlog) {
+		hostAdvance(txFree - now - backlog);
+	}
+	txFree += byteTime();
+	txBytes++;
+	peer->hostWrite(c, txFree);
+	return 1;
+}
+
+void HardwareSerial::flush()
+{
+	// wait for the transmission of outgoing data to complete
+	uint64_t now = hostMicros();
+	if (txFree > now) {
+		hostAdvance(txFree - now);
+	}
+}
+
+HardwareSerial Serial;
+HardwareSerial Serial1;
+HardwareSerial Serial2;
+HardwareSerial Serial3;
@@ -0,0 +1,187 @@
+/*
+* Host (Linux) shim of the Arduino core used by the ESP8266 HTTP Client library
+*
+* Provides just enough of the Arduino API (millis(), digitalWrite(), F(),
+* Print/Stream and HardwareSerial) to build ESP8266.cpp natively. Time is
+* virtual: it only moves forward through delay(), blocking serial writes and
+* a small fixed cost charged on every millis() call, so a run against the
+* simulated modem is fully deterministic.
+*
+* Hardware serial ports are wired to a HostSerialPeer (see SimModem.h) which
+* plays the role of the ESP8266 on the other end of the wire.
+*/
+
+#ifndef __HOST_ARDUINO_H__
+#define __HOST_ARDUINO_H__
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define HIGH 0x1
+#define LOW  0x0
+
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define INPUT_PULLUP 0x2
+
+#define DEC 10
+#define HEX 16
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+// flash strings live in ordinary memory on the host
+#define PROGMEM
+#define PGM_P const char *
+#define PSTR(s) (s)
+#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
+#define pgm_read_word(addr) (*(const uint16_t *)(addr))
+#define pgm_read_ptr(addr) (*(void * const *)(addr))
+#define strlen_P strlen
+#define strcpy_P strcpy
+#define strncpy_P strncpy
+#define strcmp_P strcmp
+#define strstr_P strstr
+#define strncmp_P strncmp
+#define memcpy_P memcpy
+
+class __FlashStringHelper;
+#define F(string_literal) (reinterpret_cast<const __FlashStringHelper *>(string_literal))
+
+// virtual clock
+unsigned long millis(void);
+unsigned long micros(void);
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+// host only: clock control
+uint64_t hostMicros(void);
+void hostAdvance(uint64_t us);
+void hostSetPollCost(uint32_t us); // virtual time charged for every millis()/micros() call
+void hostSetReadCost(uint32_t us); // and for every serial port read, 0 by default
+// host only: isr runs every periodUs of virtual time like timer interrupt, inside delay()
+// and at millis(), micros() or serial port read of running code once it is due, NULL
+// removes it
+void hostTimerInterrupt(void (*isr)(void), uint32_t periodUs);
+
+// nothing interrupts the host except hostTimerInterrupt(), interrupt due while they are
+// disabled runs at interrupts()
+void noInterrupts(void);
+void interrupts(void);
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+// host only: listeners see every digitalWrite() (e.g. simulated module RST pin)
+#define HOST_PIN_LISTENERS 4
+typedef void (*HostPinHandler)(uint8_t pin, uint8_t val, void *context);
+void hostOnPin(HostPinHandler handler, void *context);
+
+long random(long max);
+long random(long min, long max);
+void randomSeed(unsigned long seed);
+
+class Print
+{
+  public:
+	virtual ~Print() {}
+	virtual size_t write(uint8_t c) = 0;
+	virtual size_t write(const uint8_t *buffer, size_t size);
+	size_t write(const char *str) { return str == NULL ? 0 : write((const uint8_t *)str, strlen(str)); }
+	size_t write(const char *buffer, size_t size) { return write((const uint8_t *)buffer, size); }
+
+	size_t print(const __FlashStringHelper *s) { return write(reinterpret_cast<const char *>(s)); }
+	size_t print(const char s[]) { return write(s); }
+	size_t print(char c) { return write((uint8_t)c); }
+	size_t print(unsigned char n, int base = DEC) { return print((unsigned long)n, base); }
+	size_t print(int n, int base = DEC) { return print((long)n, base); }
+	size_t print(unsigned int n, int base = DEC) { return print((unsigned long)n, base); }
+	size_t print(long n, int base = DEC);
+	size_t print(unsigned long n, int base = DEC);
+	size_t print(double n, int digits = 2);
+
+	size_t println(void) { return write("\r\n"); }
+	template <typename T> size_t println(T value) { size_t n = print(value); return n + println(); }
+	template <typename T> size_t println(T value, int format) { size_t n = print(value, format); return n + println(); }
+
+	virtual void flush() {}
+};
+
+class Stream : public Print
+{
+  public:
+	virtual int available() = 0;
+	virtual int read() = 0;
+	virtual int peek() = 0;
+	void setTimeout(unsigned long) {}
+};
+
+// the other end of a host serial port
+class HostSerialPeer
+{
+  public:
+	virtual ~HostSerialPeer() {}
+	// byte written by the sketch, leaves the host TX pin at the given time
+	virtual void hostWrite(uint8_t c, uint64_t arrival) = 0;
+	// move bytes that arrived by now into the host receive FIFO
+	virtual void hostPoll(uint64_t now) = 0;
+	// the sketch changed its baud rate
+	virtual void hostBaud(unsigned long baud) = 0;
+};
+
+#define SERIAL_RX_FIFO_SIZE 64
+#define SERIAL_TX_FIFO_SIZE 64
+
+class HardwareSerial : public Stream
+{
+  public:
+	HardwareSerial();
+
+	void begin(unsigned long baud);
+	void end() {}
+	virtual int available();
+	virtual int read();
+	virtual int peek();
+	virtual void flush();
+	virtual size_t write(uint8_t c);
+	using Print::write;
+	operator bool() { return true; }
+
+	// host only: wiring and the receive side seen by the peer
+	void attach(HostSerialPeer *p) { peer = p; }
+	unsigned long baudRate() const { return baud; }
+	uint64_t byteTime() const { return 10000000ULL / baud; }
+	// called by the peer when a byte reaches the RX pin, false on FIFO overrun
+	bool deliver(uint8_t c);
+	unsigned long overruns() const { return rxOverruns; }
+	unsigned long bytesRead() const { return rxBytes; }
+	unsigned long bytesWritten() const { return txBytes; }
+
+  private:
+	HostSerialPeer *peer;
+	unsigned long baud;
+	uint8_t rxFifo[SERIAL_RX_FIFO_SIZE];
+	uint8_t rxHead;
+	uint8_t rxCount;
+	uint64_t txFree; // time the UART shifter finishes the last queued byte
+	unsigned long rxOverruns;
+	unsigned long rxBytes;
+	unsigned long txBytes;
+
+	void poll();
+};
+
+extern HardwareSerial Serial;
+extern HardwareSerial Serial1;
+extern HardwareSerial Serial2;
+extern HardwareSerial Serial3;
+
+// debug output of SoftwareSerial/Serial on the host goes here, NULL mutes it
+extern FILE *hostDebugOut;
+
+#endif
@@ -0,0 +1,113 @@
+/*
+* File descriptor transport of the host build, see HostFdTransport.h
+*/
+
+#include "HostFdTransport.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+
+HostFdTransport::HostFdTransport(int fd)
+	: reads(0), writes(0), bytesRead(0), bytesWritten(0), handle(fd), owned(false)
+{
+	if (handle >= 0) {
+		fcntl(handle, F_SETFL, fcntl(handle, F_GETFL) | O_NONBLOCK);
+	}
+}
+
+HostFdTransport::~HostFdTransport()
+{
+	close();
+}
+
+bool HostFdTransport::open(const char *path)
+{
+	close();
+	handle = ::open(path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+	if (handle < 0) {
+		return false;
+	}
+	owned = true;
+	struct termios tio;
+	if (tcgetattr(handle, &tio) == 0) {
+		cfmakeraw(&tio);
+		tcsetattr(handle, TCSANOW, &tio);
+	}
+	return true;
+}
+
+void HostFdTransport::close()
+{
+	if (owned && handle >= 0) {
+		::close(handle);
+	}
+	handle = -1;
+	owned = false;
+}
+
+void HostFdTransport::begin(unsigned long baud)
+{
+	struct termios tio;
+	if (handle < 0 || !isatty(handle) || tcgetattr(handle, &tio) != 0) {
+		return;
+	}
+	static const struct { unsigned long baud; speed_t speed; } speeds[] = {
+		{ 9600, B9600 }, { 19200, B19200 }, { 38400, B38400 }, { 57600, B57600 },
+		{ 115200, B115200 }, { 230400, B230400 }, { 460800, B460800 }, { 921600, B921600 }
+	};
+	for (size_t i = 0; i < sizeof(speeds) / sizeof(speeds[0]); i++) {
+		if (speeds[i].baud == baud) {
+			cfsetispeed(&tio, speeds[i].speed);
+			cfsetospeed(&tio, speeds[i].speed);
+			tcsetattr(handle, TCSADRAIN, &tio);
+		}
+	}
+}
+
+int HostFdTransport::available()
+{
+	int n = 0;
+	if (handle < 0 || ioctl(handle, FIONREAD, &n) != 0) {
+		return 0;
+	}
+	return n;
+}
+
+size_t HostFdTransport::read(uint8_t data[], size_t size)
+{
+	if (handle < 0 || size == 0) {
+		return 0;
+	}
+	ssize_t n = ::read(handle, data, size);
+	if (n <= 0) {
+		return 0;
+	}
+	reads++;
+	bytesRead += n;
+	return n;
+}
+
+size_t HostFdTransport::write(const uint8_t data[], size_t size)
+{
+	size_t done = 0;
+	while (handle >= 0 && done < size) {
+		ssize_t n = ::write(handle, data + done, size - done);
+		if (n > 0) {
+			done += n;
+		}
+		else if (n < 0 && errno == EAGAIN) {
+			struct pollfd p = { handle, POLLOUT, 0 };
+			poll(&p, 1, 100);
+		}
+		else if (n < 0 && errno != EINTR) {
+			break;
+		}
+	}
+	writes++;
+	bytesWritten += done;
+	return done;
+}
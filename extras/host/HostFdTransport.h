@@ -0,0 +1,51 @@
+/*
+* File descriptor transport of the host build, see ESP8266Transport.h
+*
+* Client runs over one end of a socketpair(), a pty or a serial device
+* (e.g. /dev/ttyUSB0 with real ESP8266 on it) instead of simulated port, so
+* module side can be another process or real hardware for load testing:
+*
+*	HostFdTransport port;
+*	port.open("/dev/pts/3");
+*	ESP8266Client<ESP8266Transport> wifi(port, 2);
+*
+* Timeouts of the client still run on virtual clock of the shim (see Arduino.h).
+*/
+
+#ifndef __HOST_FD_TRANSPORT_H__
+#define __HOST_FD_TRANSPORT_H__
+
+#include "ESP8266Transport.h"
+
+class HostFdTransport : public ESP8266Transport
+{
+  public:
+	// descriptor already open (socketpair()), it is switched to non-blocking mode
+	HostFdTransport(int fd = -1);
+	~HostFdTransport();
+
+	// serial device or pty in raw mode, false when it cannot be opened
+	bool open(const char *path);
+	void close();
+	int fd() const { return handle; }
+
+	// sets speed of tty, ignored on sockets
+	void begin(unsigned long baud);
+	int available();
+	size_t read(uint8_t data[], size_t size);
+	// waits until peer takes all of data
+	size_t write(const uint8_t data[], size_t size);
+	using ESP8266Transport::read;
+	using ESP8266Transport::write;
+
+	unsigned long reads;  // read() calls which got some bytes
+	unsigned long writes;
+	unsigned long bytesRead;
+	unsigned long bytesWritten;
+
+  private:
+	int handle;
+	bool owned; // opened here, closed with transport
+};
+
+#endif
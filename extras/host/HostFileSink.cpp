@@ -0,0 +1,63 @@
+/*
+* File sink of the host build, see HostFileSink.h
+*/
+
+#include "HostFileSink.h"
+#include "ESP8266.h"
+
+HostFileSink::HostFileSink(const char *_pattern, uint32_t _capacity)
+	: busyEvery(0), writes(0), refused(0), misplaced(0), shortBlocks(0),
+	pattern(_pattern), capacity(_capacity), next(0), file(NULL), written(0), lastLength(0), calls(0)
+{
+}
+
+std::string HostFileSink::path(uint16_t handle) const
+{
+	char name[256];
+	snprintf(name, sizeof(name), pattern.c_str(), (unsigned)handle);
+	return name;
+}
+
+uint16_t HostFileSink::open(uint8_t requestId, uint32_t length)
+{
+	if (file != NULL || (length != HTTP_LENGTH_UNKNOWN && length > capacity)) {
+		return SINK_NONE;
+	}
+	file = fopen(path(next).c_str(), "wb");
+	if (file == NULL) {
+		return SINK_NONE;
+	}
+	written = 0;
+	lastLength = ESP8266_SINK_BLOCK;
+	return next++;
+}
+
+boolean HostFileSink::write(uint32_t offset, const uint8_t data[], uint16_t length)
+{
+	calls++;
+	if (busyEvery > 0 && calls % busyEvery == 0) {
+		refused++;
+		return false;
+	}
+	if (offset != written) {
+		misplaced++;
+	}
+	if (lastLength != ESP8266_SINK_BLOCK) {
+		// only the last block may be short
+		shortBlocks++;
+	}
+	lastLength = length;
+	fseek(file, offset, SEEK_SET);
+	fwrite(data, 1, length, file);
+	written = offset + length;
+	writes++;
+	return true;
+}
+
+void HostFileSink::close(boolean complete)
+{
+	if (file != NULL) {
+		fclose(file);
+		file = NULL;
+	}
+}
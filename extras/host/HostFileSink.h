@@ -0,0 +1,45 @@
+/*
+* File sink of the host build, see ESP8266Sink.h
+*
+* Every stored body is a file made from a printf pattern with the handle
+* (0, 1, 2...), e.g. "/tmp/body%u.bin". Storage can pretend to be busy to
+* exercise back-pressure: every busyEvery-th write is refused once.
+*/
+
+#ifndef __HOST_FILE_SINK_H__
+#define __HOST_FILE_SINK_H__
+
+#include "ESP8266Sink.h"
+
+#include <stdio.h>
+#include <string>
+
+class HostFileSink : public ESP8266Sink
+{
+  public:
+	HostFileSink(const char *pattern, uint32_t capacity = 0xFFFFFFFF);
+
+	uint16_t open(uint8_t requestId, uint32_t length);
+	boolean write(uint32_t offset, const uint8_t data[], uint16_t length);
+	void close(boolean complete);
+
+	// name of the file of the given handle
+	std::string path(uint16_t handle) const;
+
+	unsigned busyEvery;   // 0 = never busy
+	unsigned long writes; // accepted
+	unsigned long refused;
+	unsigned long misplaced; // blocks not written right after the previous one
+	unsigned long shortBlocks; // blocks shorter than ESP8266_SINK_BLOCK before the last one
+
+  private:
+	std::string pattern;
+	uint32_t capacity; // open() refuses longer bodies
+	uint16_t next;
+	FILE *file;
+	uint32_t written;
+	uint16_t lastLength;
+	unsigned long calls;
+};
+
+#endif
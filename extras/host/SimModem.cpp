@@ -0,0 +1,655 @@
+/*
+* Simulated ESP8266 AT modem for the host build, see SimModem.h
+*/
+
+#include "SimModem.h"
+
+#include <algorithm>
+
+static bool startsWith(const std::string &s, const char *prefix)
+{
+	return s.compare(0, strlen(prefix), prefix) == 0;
+}
+
+static std::string lower(std::string s)
+{
+	for (size_t i = 0; i < s.size(); i++) {
+		if (s[i] >= 'A' && s[i] <= 'Z') {
+			s[i] = s[i] - 'A' + 'a';
+		}
+	}
+	return s;
+}
+
+// split AT command arguments on commas outside of quotes, quotes removed
+static std::vector<std::string> arguments(const std::string &cmd)
+{
+	std::vector<std::string> args;
+	size_t eq = cmd.find('=');
+	if (eq == std::string::npos) {
+		return args;
+	}
+	std::string arg;
+	bool quoted = false;
+	for (size_t i = eq + 1; i < cmd.size(); i++) {
+		char c = cmd[i];
+		if (c == '"') {
+			quoted = !quoted;
+		}
+		else if (c == ',' && !quoted) {
+			args.push_back(arg);
+			arg.clear();
+		}
+		else {
+			arg += c;
+		}
+	}
+	args.push_back(arg);
+	return args;
+}
+
+std::string SimRequest::header(const char *name) const
+{
+	std::string key = lower(name) + ":";
+	size_t start = 0;
+	while (start < headers.size()) {
+		size_t end = headers.find("\r\n", start);
+		if (end == std::string::npos) {
+			end = headers.size();
+		}
+		std::string line = headers.substr(start, end - start);
+		if (lower(line.substr(0, key.size())) == key) {
+			size_t v = key.size();
+			while (v < line.size() && line[v] == ' ') {
+				v++;
+			}
+			return line.substr(v);
+		}
+		start = end + 2;
+	}
+	return "";
+}
+
+
+
+SimModem::SimModem(HardwareSerial &_port)
+	: port(_port), eventSeq(0), lineFree(0), now(0), mux(false), joined(false), bootUntil(0), bootBaud(0),
+	sendLink(-1), cipmode(false), passthrough(false), lastFromHost(0), escapePlus(0), sendLeft(0)
+{
+	for (int i = 0; i < SIM_MAX_LINKS; i++) {
+		links[i].open = false;
+		links[i].port = 0;
+		links[i].busyUntil = 0;
+		links[i].lastActivity = 0;
+	}
+	port.attach(this);
+	hostOnPin(pinChanged, this);
+}
+
+void SimModem::pinChanged(uint8_t pin, uint8_t val, void *context)
+{
+	SimModem *modem = (SimModem *)context;
+	if (modem->config.resetPin >= 0 && pin == modem->config.resetPin && val == LOW) {
+		modem->now = hostMicros();
+		modem->incoming.clear();
+		modem->events.clear();
+		modem->sendLink = -1;
+		modem->command.clear();
+		modem->reboot();
+	}
+}
+
+void SimModem::route(const char *host, uint16_t port, SimHandler handler)
+{
+	Route r;
+	r.host = host;
+	r.port = port;
+	r.handler = handler;
+	routes.push_back(r);
+}
+
+const SimModem::Route *SimModem::findRoute(const std::string &host, uint16_t p) const
+{
+	for (size_t i = 0; i < routes.size(); i++) {
+		if ((routes[i].host == "*" || routes[i].host == host) && (routes[i].port == 0 || routes[i].port == p)) {
+			return &routes[i];
+		}
+	}
+	return NULL;
+}
+
+std::string SimModem::address(const std::string &host)
+{
+	std::map<std::string, std::string>::iterator a = addresses.find(host);
+	if (a != addresses.end()) {
+		return a->second;
+	}
+	for (size_t i = 0; i < routes.size(); i++) {
+		if (routes[i].host == "*" || routes[i].host == host) {
+			unsigned n = addresses.size() + 1;
+			return addresses[host] = "10.0." + std::to_string(n / 256) + "." + std::to_string(n % 256);
+		}
+	}
+	return "";
+}
+
+void SimModem::setAddress(const std::string &host, const std::string &address)
+{
+	addresses[host] = address;
+}
+
+std::string SimModem::hostOf(const std::string &address) const
+{
+	for (std::map<std::string, std::string>::const_iterator a = addresses.begin(); a != addresses.end(); a++) {
+		if (a->second == address) {
+			return a->first;
+		}
+	}
+	return address;
+}
+
+uint8_t SimModem::openLinks() const
+{
+	uint8_t n = 0;
+	for (int i = 0; i < SIM_MAX_LINKS; i++) {
+		if (links[i].open) {
+			n++;
+		}
+	}
+	return n;
+}
+
+std::string SimModem::linkPrefix(uint8_t link) const
+{
+	return mux ? std::to_string(link) + "," : std::string();
+}
+
+
+
+void SimModem::emit(uint64_t at, const std::string &bytes, unsigned long baud)
+{
+	Event e;
+	e.at = at;
+	e.seq = eventSeq++;
+	e.bytes = bytes;
+	e.baud = baud;
+	events.push_back(e);
+}
+
+bool SimModem::clean(unsigned long baud) const
+{
+	return port.baudRate() == baud && (config.cleanBaud == 0 || baud <= config.cleanBaud);
+}
+
+void SimModem::hostWrite(uint8_t c, uint64_t arrival)
+{
+	Byte b;
+	b.c = clean(config.baud) ? c : 0xFF;
+	b.at = arrival;
+	b.baud = config.baud;
+	incoming.push_back(b);
+	stats.bytesFromHost++;
+}
+
+void SimModem::hostBaud(unsigned long)
+{
+	// nothing to do, the mismatch is checked on every byte
+}
+
+void SimModem::hostPoll(uint64_t t)
+{
+	// modem side processing of what the host sent, in arrival order
+	while (!incoming.empty() && incoming.front().at <= t) {
+		now = incoming.front().at;
+		uint8_t c = incoming.front().c;
+		incoming.pop_front();
+		receive(c);
+	}
+	now = t;
+	escapeCheck();
+
+	if (config.serverIdleMs > 0) {
+		for (uint8_t i = 0; i < SIM_MAX_LINKS; i++) {
+			if (links[i].open && now - links[i].lastActivity > (uint64_t)config.serverIdleMs * 1000
+				&& links[i].busyUntil < now) {
+				dropLink(i, now);
+			}
+		}
+	}
+
+	// commit due output to the wire, earliest first
+	while (true) {
+		size_t next = events.size();
+		for (size_t i = 0; i < events.size(); i++) {
+			if (events[i].at <= t && (next == events.size() || events[i].at < events[next].at
+				|| (events[i].at == events[next].at && events[i].seq < events[next].seq))) {
+				next = i;
+			}
+		}
+		if (next == events.size()) {
+			break;
+		}
+		if (lineFree < events[next].at) {
+			lineFree = events[next].at;
+		}
+		if (events[next].baud != 0) {
+			// takes effect once everything before it is out
+			config.baud = events[next].baud;
+		}
+		uint64_t byteTime = 10000000ULL / config.baud;
+		for (size_t i = 0; i < events[next].bytes.size(); i++) {
+			lineFree += byteTime;
+			Byte b;
+			b.c = events[next].bytes[i];
+			b.at = lineFree;
+			b.baud = config.baud;
+			line.push_back(b);
+		}
+		events.erase(events.begin() + next);
+	}
+
+	while (!line.empty() && line.front().at <= t) {
+		uint8_t c = line.front().c;
+		if (!clean(line.front().baud)) {
+			c = (c ^ 0x5A) | 0x80;
+			stats.garbled++;
+		}
+		port.deliver(c);
+		stats.bytesToHost++;
+		line.pop_front();
+	}
+}
+
+
+
+void SimModem::receive(uint8_t c)
+{
+	escapeCheck();
+	if (passthrough) {
+		passthroughByte(c);
+		return;
+	}
+	if (sendLink >= 0) {
+		sendData += (char)c;
+		if (--sendLeft == 0) {
+			finishSend();
+		}
+		return;
+	}
+	if (now < bootUntil) {
+		return;
+	}
+
+	command += (char)c;
+	if (command.size() > 512) {
+		command.clear();
+	}
+	if (c != '\n') {
+		return;
+	}
+
+	std::string cmd = command;
+	command.clear();
+	while (!cmd.empty() && (cmd[cmd.size() - 1] == '\n' || cmd[cmd.size() - 1] == '\r')) {
+		cmd.erase(cmd.size() - 1);
+	}
+	if (config.echo) {
+		emit(now, cmd + "\r\n");
+	}
+	if (!cmd.empty()) {
+		execute(cmd);
+	}
+}
+
+void SimModem::reboot()
+{
+	closeAll();
+	joined = false;
+	mux = false;
+	cipmode = false;
+	passthrough = false;
+	escapePlus = 0;
+	if (bootBaud == 0) {
+		bootBaud = config.baud;
+	}
+	// anything sent while the module is rebooting is lost
+	bootUntil = now + (uint64_t)config.resetMs * 1000;
+	// AT+UART_CUR does not survive reset
+	emit(bootUntil, "", bootBaud);
+	emit(bootUntil, "\r\n\x02\xc3\x8a\x10\r\n[Vendor:www.ai-thinker.com Version:0.9.2.4]\r\n\r\nready\r\n");
+}
+
+void SimModem::execute(const std::string &cmd)
+{
+	stats.commands++;
+	std::vector<std::string> args = arguments(cmd);
+	if (bootBaud == 0) {
+		bootBaud = config.baud;
+	}
+
+	if (cmd == "AT") {
+		emitNow("\r\nOK\r\n");
+	}
+	else if (cmd == "AT+RST") {
+		emitNow("\r\nOK\r\n");
+		reboot();
+	}
+	else if (startsWith(cmd, "AT+CIOBAUD=") || (config.uartCur && startsWith(cmd, "AT+UART_CUR="))) {
+		unsigned long baud = args.size() > 0 ? strtoul(args[0].c_str(), NULL, 10) : 0;
+		if (baud < 9600 || baud > config.maxBaud) {
+			emitNow("\r\nERROR\r\n");
+			return;
+		}
+		// OK still goes out at the old speed
+		emitNow("\r\nOK\r\n");
+		emit(now + config.commandUs, "", baud);
+		if (startsWith(cmd, "AT+CIOBAUD=")) {
+			bootBaud = baud;
+		}
+	}
+	else if (startsWith(cmd, "AT+CWMODE=")) {
+		emitNow("\r\nOK\r\n");
+	}
+	else if (startsWith(cmd, "AT+CIPMUX=")) {
+		if (cipmode) {
+			emitNow("\r\nERROR\r\n");
+		}
+		else if (openLinks() > 0) {
+			emitNow("link is builded\r\n");
+		}
+		else {
+			mux = args.size() > 0 && args[0] == "1";
+			emitNow("\r\nOK\r\n");
+		}
+	}
+	else if (startsWith(cmd, "AT+CWJAP=")) {
+		bool ok = args.size() == 2 && (config.password == NULL || args[1] == config.password);
+		joined = ok;
+		emit(now + (uint64_t)config.joinMs * 1000, ok ? "\r\nOK\r\n" : "\r\nFAIL\r\n");
+	}
+	else if (cmd == "AT+CWQAP") {
+		closeAll();
+		joined = false;
+		emitNow("\r\nOK\r\n");
+	}
+	else if (cmd == "AT+CIFSR") {
+		emitNow(std::string("+CIFSR:STAIP,\"") + (joined ? config.ip : "0.0.0.0") + "\"\r\n\r\nOK\r\n");
+	}
+	else if (cmd == "AT+CIPSTATUS") {
+		uint8_t open = openLinks();
+		std::string out = "STATUS:" + std::to_string(open > 0 ? 3 : (joined ? 2 : 4)) + "\r\n";
+		for (uint8_t i = 0; i < SIM_MAX_LINKS; i++) {
+			if (links[i].open) {
+				out += "+CIPSTATUS:" + std::to_string(i) + ",\"TCP\",\"" + links[i].host + "\","
+					+ std::to_string(links[i].port) + ",0\r\n";
+			}
+		}
+		emitNow(out + "\r\nOK\r\n");
+	}
+	else if (startsWith(cmd, "AT+CIPSTART=")) {
+		size_t base = mux ? 1 : 0;
+		int id = mux && args.size() > 0 ? atoi(args[0].c_str()) : 0;
+		if (args.size() != base + 3 || id < 0 || id >= SIM_MAX_LINKS || !joined) {
+			emitNow("\r\nERROR\r\n");
+			return;
+		}
+		Link &l = links[id];
+		if (l.open) {
+			emitNow("ALREAY CONNECT\r\n");
+			return;
+		}
+		std::string host = args[base + 1];
+		uint16_t p = (uint16_t)atoi(args[base + 2].c_str());
+		uint64_t at = now + (uint64_t)config.connectMs * 1000;
+		if (host.find_first_not_of("0123456789.") != std::string::npos) {
+			// module looks the name up on every connect
+			stats.lookups++;
+			at += (uint64_t)config.dnsMs * 1000;
+		}
+		else {
+			host = hostOf(host);
+		}
+		if (findRoute(host, p) == NULL) {
+			emit(at - (uint64_t)config.connectMs * 1000 + (uint64_t)config.deadMs * 1000, "\r\nERROR\r\nUnlink\r\n");
+			return;
+		}
+		l.open = true;
+		l.host = host;
+		l.port = p;
+		l.inbox.clear();
+		l.busyUntil = at;
+		l.lastActivity = at;
+		stats.connects++;
+		emit(at, "\r\nOK\r\nLinked\r\n");
+	}
+	else if (startsWith(cmd, "AT+CIPDOMAIN=") && config.cipDomain) {
+		uint64_t at = now + config.commandUs + (uint64_t)config.dnsMs * 1000;
+		std::string a = args.size() == 1 && joined ? address(args[0]) : "";
+		if (a.empty()) {
+			emit(at, "DNS Fail\r\n\r\nERROR\r\n");
+			return;
+		}
+		stats.lookups++;
+		emit(at, "+CIPDOMAIN:" + a + "\r\n\r\nOK\r\n");
+	}
+	else if (startsWith(cmd, "AT+CIPMODE=")) {
+		if (mux) {
+			emitNow("\r\nERROR\r\n");
+		}
+		else {
+			cipmode = args.size() > 0 && args[0] == "1";
+			emitNow("\r\nOK\r\n");
+		}
+	}
+	else if (cmd == "AT+CIPSEND") {
+		if (!cipmode) {
+			emitNow("\r\nERROR\r\n");
+		}
+		else if (!links[0].open) {
+			emitNow("link is not\r\n");
+		}
+		else {
+			passthrough = true;
+			escapePlus = 0;
+			lastFromHost = now;
+			stats.passthroughs++;
+			emitNow("\r\nOK\r\n> ");
+		}
+	}
+	else if (startsWith(cmd, "AT+CIPSEND=") && cipmode) {
+		emitNow("\r\nERROR\r\n");
+	}
+	else if (startsWith(cmd, "AT+CIPSEND=")) {
+		int id = mux && args.size() == 2 ? atoi(args[0].c_str()) : 0;
+		int len = args.size() > 0 ? atoi(args[args.size() - 1].c_str()) : 0;
+		if ((mux ? 2u : 1u) != args.size() || id < 0 || id >= SIM_MAX_LINKS || len <= 0 || len > 2048) {
+			emitNow("\r\nERROR\r\n");
+		}
+		else if (!links[id].open) {
+			emitNow("link is not\r\n");
+		}
+		else {
+			sendLink = id;
+			sendLeft = len;
+			sendData.clear();
+			emitNow("> ");
+		}
+	}
+	else if (startsWith(cmd, "AT+CIPCLOSE")) {
+		int id = mux && args.size() > 0 ? atoi(args[0].c_str()) : 0;
+		if (id == 5) {
+			closeAll();
+			emitNow("\r\nOK\r\n");
+		}
+		else if (id >= 0 && id < SIM_MAX_LINKS && links[id].open) {
+			links[id].open = false;
+			emitNow("\r\nOK\r\n" + (mux ? linkPrefix(id) + "CLOSED\r\n" : std::string("Unlink\r\n")));
+		}
+		else {
+			emitNow("\r\nERROR\r\n");
+		}
+	}
+	else {
+		emitNow("no this fun\r\n\r\nERROR\r\n");
+	}
+}
+
+void SimModem::finishSend()
+{
+	uint8_t id = sendLink;
+	sendLink = -1;
+	links[id].inbox += sendData;
+	links[id].lastActivity = now;
+	sendData.clear();
+	stats.sends++;
+	emit(now + (uint64_t)config.sendMs * 1000, "\r\nSEND OK\r\n");
+	serve(id);
+}
+
+void SimModem::passthroughByte(uint8_t c)
+{
+	// "+++" is an escape only with silence before it (and after, see escapeCheck())
+	uint64_t guard = (uint64_t)config.escapeGuardMs * 1000;
+	if (c == '+' && escapePlus < 3 && (escapePlus > 0 || now - lastFromHost >= guard)) {
+		escapePlus++;
+		lastFromHost = now;
+		return;
+	}
+	lastFromHost = now;
+
+	Link &l = links[0];
+	if (!l.open) {
+		// later firmware reconnects by itself in transparent transmission
+		l.open = true;
+		l.inbox.clear();
+		l.busyUntil = now + (uint64_t)config.connectMs * 1000;
+		stats.connects++;
+	}
+	l.inbox.append(escapePlus, '+');
+	escapePlus = 0;
+	l.inbox += (char)c;
+	l.lastActivity = now;
+	serve(0);
+}
+
+void SimModem::escapeCheck()
+{
+	if (passthrough && escapePlus == 3 && now - lastFromHost >= (uint64_t)config.escapeGuardMs * 1000) {
+		passthrough = false;
+		escapePlus = 0;
+		stats.escapes++;
+	}
+}
+
+void SimModem::serve(uint8_t id)
+{
+	Link &l = links[id];
+	while (true) {
+		// requests on a keep-alive socket may be separated by stray line breaks
+		size_t start = 0;
+		while (start < l.inbox.size() && (l.inbox[start] == '\r' || l.inbox[start] == '\n')) {
+			start++;
+		}
+		l.inbox.erase(0, start);
+		size_t headEnd = l.inbox.find("\r\n\r\n");
+		if (headEnd == std::string::npos) {
+			return;
+		}
+
+		SimRequest request;
+		request.host = l.host;
+		request.port = l.port;
+		size_t lineEnd = l.inbox.find("\r\n");
+		std::string requestLine = l.inbox.substr(0, lineEnd);
+		request.headers = lineEnd < headEnd ? l.inbox.substr(lineEnd + 2, headEnd - lineEnd) : "";
+		size_t sp1 = requestLine.find(' ');
+		size_t sp2 = requestLine.find(' ', sp1 + 1);
+		request.method = requestLine.substr(0, sp1);
+		request.url = sp1 == std::string::npos ? "" : requestLine.substr(sp1 + 1, sp2 - sp1 - 1);
+
+		size_t bodyLength = (size_t)atol(request.header("Content-Length").c_str());
+		if (l.inbox.size() < headEnd + 4 + bodyLength) {
+			return;
+		}
+		request.body = l.inbox.substr(headEnd + 4, bodyLength);
+		l.inbox.erase(0, headEnd + 4 + bodyLength);
+		stats.requests++;
+
+		const Route *r = findRoute(l.host, l.port);
+		SimResponse response;
+		if (r != NULL) {
+			r->handler(request, response);
+		}
+		else {
+			response.status = 404;
+			response.reason = "Not Found";
+		}
+		if (!response.drop) {
+			respond(id, response);
+		}
+		if (!l.open) {
+			return;
+		}
+	}
+}
+
+void SimModem::respond(uint8_t id, const SimResponse &response)
+{
+	Link &l = links[id];
+	uint64_t at = now + (uint64_t)(config.sendMs + response.latencyMs) * 1000;
+	if (at < l.busyUntil) {
+		at = l.busyUntil;
+	}
+
+	std::string http = "HTTP/1.1 " + std::to_string(response.status) + " " + response.reason + "\r\n";
+	if (response.contentLength) {
+		http += "Content-Length: " + std::to_string(response.body.size()) + "\r\n";
+	}
+	if (response.close) {
+		http += "Connection: close\r\n";
+	}
+	http += response.headers + "\r\n" + response.body;
+
+	if (passthrough) {
+		// raw, no +IPD framing
+		emit(at, http);
+	}
+	for (size_t off = 0; !passthrough && off < http.size(); off += config.ipdChunk) {
+		std::string chunk = http.substr(off, config.ipdChunk);
+		if (off > 0) {
+			at += config.ipdGapUs;
+		}
+		emit(at, "\r\n+IPD," + linkPrefix(id) + std::to_string(chunk.size()) + ":" + chunk + "\r\nOK\r\n");
+	}
+	stats.responses++;
+	l.busyUntil = at;
+	l.lastActivity = at;
+
+	if (response.close) {
+		dropLink(id, at);
+	}
+}
+
+void SimModem::serverClose(uint8_t id)
+{
+	if (id < SIM_MAX_LINKS && links[id].open) {
+		dropLink(id, now > links[id].busyUntil ? now : links[id].busyUntil);
+	}
+}
+
+void SimModem::dropLink(uint8_t id, uint64_t at)
+{
+	links[id].open = false;
+	links[id].inbox.clear();
+	if (!passthrough) {
+		emit(at, mux ? linkPrefix(id) + "CLOSED\r\n" : std::string("Unlink\r\n"));
+	}
+}
+
+void SimModem::closeAll()
+{
+	for (int i = 0; i < SIM_MAX_LINKS; i++) {
+		links[i].open = false;
+		links[i].inbox.clear();
+	}
+}
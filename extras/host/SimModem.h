@@ -0,0 +1,198 @@
+/*
+* Simulated ESP8266 AT modem for the host build
+*
+* Sits on the other end of a HardwareSerial shim port and answers the AT
+* command set the way firmware v0.20 does (command echo, "\r\nOK\r\n",
+* "ALREAY CONNECT", "+IPD,<len>:<data>\r\nOK\r\n", "Linked"/"Unlink"...), plus
+* transparent transmission (AT+CIPMODE=1, "+++") and AT+CIPDOMAIN the way later
+* AT firmware does.
+* Bytes in both directions are paced at the configured baud rate, and a baud
+* mismatch between the sketch and the modem garbles the line like real
+* hardware does.
+*
+* TCP peers are local HTTP stand-ins registered with route(); each one is a
+* plain function that fills in a SimResponse for a parsed SimRequest.
+*/
+
+#ifndef __SIM_MODEM_H__
+#define __SIM_MODEM_H__
+
+#include "Arduino.h"
+
+#include <deque>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#define SIM_MAX_LINKS 5
+
+struct SimRequest {
+	std::string host;
+	uint16_t port;
+	std::string method;
+	std::string url;
+	std::string headers; // raw header block, one "Name: value\r\n" per line
+	std::string body;
+
+	// value of the given header or empty string, name is case insensitive
+	std::string header(const char *name) const;
+};
+
+struct SimResponse {
+	int status;
+	std::string reason;
+	std::string headers; // extra raw header lines, each ending with "\r\n"
+	std::string body;
+	bool contentLength; // send Content-Length header
+	bool close;         // server closes the socket after this response
+	bool drop;          // never answer (injected timeout)
+	uint32_t latencyMs; // server think time
+
+	SimResponse() : status(200), reason("OK"), contentLength(true), close(false), drop(false), latencyMs(20) {}
+};
+
+typedef std::function<void(const SimRequest &request, SimResponse &response)> SimHandler;
+
+struct SimConfig {
+	unsigned long baud;       // modem UART speed, AT+CIOBAUD changes it for good, AT+UART_CUR until reset
+	unsigned long maxBaud;    // highest speed AT+CIOBAUD/AT+UART_CUR accept
+	unsigned long cleanBaud;  // wiring garbles everything faster than this, 0 = any speed is clean
+	bool uartCur;             // firmware knows AT+UART_CUR (v0.20 has only AT+CIOBAUD)
+	bool cipDomain;           // firmware knows AT+CIPDOMAIN
+	uint32_t commandUs;       // time to answer a local AT command
+	uint32_t resetMs;         // AT+RST until "ready"
+	uint32_t joinMs;          // AT+CWJAP until "OK"
+	uint32_t connectMs;       // AT+CIPSTART until "Linked" (TCP handshake)
+	uint32_t dnsMs;           // hostname lookup, paid by AT+CIPDOMAIN and AT+CIPSTART to a name
+	uint32_t deadMs;          // AT+CIPSTART to host without route until ERROR (TCP connect timeout)
+	uint32_t sendMs;          // last CIPSEND byte until "SEND OK"
+	uint32_t ipdChunk;        // max payload bytes per +IPD frame
+	uint32_t ipdGapUs;        // time between +IPD frames of one response, frames of other links fit in
+	uint32_t serverIdleMs;    // server closes idle keep-alive sockets, 0 = never
+	uint32_t escapeGuardMs;   // silence needed around "+++" to leave transparent transmission
+	bool echo;                // ATE1
+	const char *password;     // expected AP password, NULL accepts any
+	const char *ip;           // station IP reported by AT+CIFSR
+	int resetPin;             // host pin wired to module RST (active low), -1 = not wired
+
+	SimConfig()
+		: baud(115200), maxBaud(921600), cleanBaud(0), uartCur(false), cipDomain(false), commandUs(1500), resetMs(600), joinMs(1500), connectMs(40), dnsMs(80), deadMs(3000), sendMs(15),
+		ipdChunk(1460), ipdGapUs(0), serverIdleMs(0), escapeGuardMs(1000), echo(true), password(NULL), ip("192.168.1.50"), resetPin(-1) {}
+};
+
+struct SimStats {
+	unsigned long commands;
+	unsigned long connects;
+	unsigned long lookups; // hostnames resolved by module
+	unsigned long requests;
+	unsigned long responses;
+	unsigned long bytesToHost;
+	unsigned long bytesFromHost;
+	unsigned long garbled;
+	unsigned long sends;        // AT+CIPSEND=<length> frames received in full
+	unsigned long passthroughs; // transparent transmission started by AT+CIPSEND
+	unsigned long escapes;      // and left with "+++"
+
+	SimStats() : commands(0), connects(0), lookups(0), requests(0), responses(0), bytesToHost(0), bytesFromHost(0), garbled(0),
+		sends(0), passthroughs(0), escapes(0) {}
+};
+
+class SimModem : public HostSerialPeer
+{
+  public:
+	SimModem(HardwareSerial &port);
+
+	SimConfig config;
+	SimStats stats;
+
+	// register an HTTP stand-in for host:port, host "*" and port 0 match anything
+	void route(const char *host, uint16_t port, SimHandler handler);
+	// server side close of an open link
+	void serverClose(uint8_t link);
+	// number of links currently open
+	uint8_t openLinks() const;
+	// address of hostname served by some route (assigned on first lookup), empty when none
+	std::string address(const std::string &host);
+	// move host to another address, connects to the old one fail
+	void setAddress(const std::string &host, const std::string &address);
+
+	// HostSerialPeer
+	virtual void hostWrite(uint8_t c, uint64_t arrival);
+	virtual void hostPoll(uint64_t now);
+	virtual void hostBaud(unsigned long baud);
+
+  private:
+	struct Route {
+		std::string host;
+		uint16_t port;
+		SimHandler handler;
+	};
+
+	struct Link {
+		bool open;
+		std::string host;
+		uint16_t port;
+		std::string inbox;   // request bytes not parsed yet
+		uint64_t busyUntil;  // responses on one socket leave in order
+		uint64_t lastActivity;
+	};
+
+	struct Event {
+		uint64_t at;
+		unsigned long seq;
+		std::string bytes;
+		unsigned long baud; // switch UART to this speed instead of sending bytes, 0 = none
+	};
+
+	struct Byte {
+		uint8_t c;
+		uint64_t at;
+		unsigned long baud; // speed it was sent with
+	};
+
+	HardwareSerial &port;
+	std::vector<Route> routes;
+	std::map<std::string, std::string> addresses; // of looked up hostnames
+	Link links[SIM_MAX_LINKS];
+	std::deque<Byte> incoming;  // host -> modem, not processed yet
+	std::vector<Event> events;  // modem output waiting for its time
+	std::deque<Byte> line;      // modem -> host, committed to the wire
+	unsigned long eventSeq;
+	uint64_t lineFree;
+	uint64_t now;
+
+	std::string command;
+	bool mux;
+	bool joined;
+	uint64_t bootUntil;
+	unsigned long bootBaud; // UART speed after reset, 0 until first command
+	int sendLink;       // link of the CIPSEND in progress, -1 in command mode
+	bool cipmode;       // AT+CIPMODE=1
+	bool passthrough;   // transparent transmission, host bytes go straight to link 0
+	uint64_t lastFromHost;
+	uint8_t escapePlus; // '+' of possible escape sequence held back
+	uint32_t sendLeft;  // bytes still expected for it
+	std::string sendData;
+
+	void emit(uint64_t at, const std::string &bytes, unsigned long baud = 0);
+	bool clean(unsigned long baud) const;
+	void emitNow(const std::string &bytes) { emit(now + config.commandUs, bytes); }
+	void receive(uint8_t c);
+	void execute(const std::string &cmd);
+	void finishSend();
+	void passthroughByte(uint8_t c);
+	void escapeCheck();
+	void reboot();
+	static void pinChanged(uint8_t pin, uint8_t val, void *context);
+	void serve(uint8_t link);
+	void respond(uint8_t link, const SimResponse &response);
+	void dropLink(uint8_t link, uint64_t at);
+	void closeAll();
+	const Route *findRoute(const std::string &host, uint16_t port) const;
+	// hostname given address was handed out for, address itself when unknown
+	std::string hostOf(const std::string &address) const;
+	std::string linkPrefix(uint8_t link) const;
+};
+
+#endif
@@ -0,0 +1,30 @@
+/*
+* Host (Linux) shim of SoftwareSerial, used only as the debug console.
+* Everything printed goes to hostDebugOut, nothing is ever received.
+*/
+
+#ifndef __HOST_SOFTWARE_SERIAL_H__
+#define __HOST_SOFTWARE_SERIAL_H__
+
+#include "Arduino.h"
+
+class SoftwareSerial : public Stream
+{
+  public:
+	SoftwareSerial(uint8_t, uint8_t) {}
+
+	void begin(unsigned long) {}
+	virtual int available() { return 0; }
+	virtual int read() { return -1; }
+	virtual int peek() { return -1; }
+	virtual size_t write(uint8_t c)
+	{
+		if (hostDebugOut != NULL) {
+			fputc(c, hostDebugOut);
+		}
+		return 1;
+	}
+	using Print::write;
+};
+
+#endif
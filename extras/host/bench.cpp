@@ -0,0 +1,264 @@
+/*
+* Benchmark of the ESP8266 HTTP Client library against the simulated ESP8266
+*
+* Every scenario runs the real state machine in its own process (fresh library
+* and virtual clock) and reports one JSON object: requests and payload bytes
+* per second and request latency percentiles in virtual time (deterministic
+* for given revision), cost of update() calls in host wall time and CPU cycles
+* (depends on machine, compare runs from the same one), peak internal buffer
+* occupancy. Exit status is number of scenarios where some request did not end
+* or failed without being dropped by server (lossy baseline may fail).
+*
+* usage: bench [scenario...]    (all scenarios when none given)
+*/
+
+#include <ESP8266.h>
+#include "SimModem.h"
+#include "HostFileSink.h"
+
+#include <algorithm>
+#include <vector>
+#include <time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#if defined(__x86_64__) || defined(__i386__)
+	#include <x86intrin.h>
+#endif
+
+#ifndef ESP8266_TRACING
+	#error bench counts completed requests with trace handler, build with ESP8266_TRACING
+#endif
+
+#ifndef BENCH_REVISION
+	#define BENCH_REVISION "unknown"
+#endif
+
+// virtual time limit of one scenario
+#define BENCH_LIMIT_S 900
+
+struct Scenario {
+	const char *name;
+	boolean multiplex;
+	boolean transparent;   // AT+CIPMODE=1 to the (single) host
+	uint8_t pipelining;
+	uint8_t hosts;         // requests go to hosts in round robin
+	const char *method;
+	size_t postBytes;      // longer than one CIPSEND frame is pulled from producer
+	size_t responseBytes;
+	boolean streaming;     // body goes to chunk handler instead of internal buffer
+	unsigned dropEvery;    // server never answers every n-th request, 0 = none
+	unsigned requests;
+	unsigned stallMs;      // loop() is busy this long after every update()
+	uint32_t rxInterruptUs; // period of timer interrupt calling rxEvent(), 0 = none
+	boolean stored;        // body bigger than buffer goes to file sink
+	uint8_t batching;      // framing of merged POST bodies, BATCH_OFF = every POST on its own
+	boolean lossy;         // requests fail for good (baseline), others fail only when dropped
+};
+
+static const Scenario scenarios[] = {
+	{ "small_get",           false, false, 1, 1, METHOD_GET,  0,    64,   false, 0, 100 },
+	{ "small_get_pipelined", false, false, 4, 1, METHOD_GET,  0,    64,   false, 0, 100 },
+	{ "large_post",          false, false, 1, 1, METHOD_POST, 1500, 32,   false, 0, 50 },
+	{ "streamed_post",       false, false, 1, 1, METHOD_POST, 8000, 32,   false, 0, 20 },
+	{ "large_get",           false, false, 1, 1, METHOD_GET,  0,    4000, true,  0, 20 },
+	// link part of buffer holds (SERIAL_RX_BUFFER_SIZE - ESP8266_MUX_CMD_BUFFER) / ESP8266_MAX_LINKS bytes
+	{ "round_robin",         true,  false, 1, 4, METHOD_GET,  0,    64,   false, 0, 100 },
+	{ "timeouts",            true,  false, 1, 2, METHOD_GET,  0,    64,   false, 5, 40 },
+	{ "transparent_post",    false, true,  1, 1, METHOD_POST, 64,   32,   false, 0, 100 },
+	// 10 ms of 115200 baud is more than serial port holds, receive ring takes the rest when
+	// timer interrupt fills it, without it serial port overflows and nothing gets through
+	{ "stalled_loop",        false, false, 1, 1, METHOD_GET,  0,    1000, true,  0, 20,  10, 0,    false, BATCH_OFF, true },
+	{ "stalled_loop_isr",    false, false, 1, 1, METHOD_GET,  0,    1000, true,  0, 20,  10, 1000 },
+	{ "stored_get",          false, false, 1, 1, METHOD_GET,  0,    6000, false, 0, 20,  0,  0,    true },
+	// telemetry, many tiny POSTs to one endpoint
+	{ "small_post",          false, false, 1, 1, METHOD_POST, 16,   32,   false, 0, 100 },
+	{ "batched_post",        false, false, 1, 1, METHOD_POST, 16,   32,   false, 0, 100, 0,  0,    false, BATCH_JSON },
+};
+
+static char hostNames[4][16] = { "h0.bench", "h1.bench", "h2.bench", "h3.bench" };
+
+// per run results, indexed by request id (unique while request is queued or in flight)
+static uint64_t enqueued[256];
+static std::vector<double> latencies;
+static unsigned completed;
+static unsigned failed;
+static unsigned long long payloadBytes;
+
+static uint64_t wallNanos() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static uint64_t cycles() {
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	return 0;
+#endif
+}
+
+static double percentile(std::vector<double> v, double p) {
+	if (v.empty()) {
+		return 0;
+	}
+	std::sort(v.begin(), v.end());
+	size_t i = (size_t)(p * (v.size() - 1) + 0.5);
+	return v[i];
+}
+
+static size_t producer(char data[], size_t offset, size_t size) {
+	memset(data, 'p', size);
+	return size;
+}
+
+static void dataHandler(int code, char data[]) {
+	payloadBytes += wifi.getResponseLength();
+}
+
+static void chunkHandler(const char data[], size_t length) {
+	payloadBytes += length;
+}
+
+static void endHandler(int code) {
+}
+
+static void storedHandler(int code, uint16_t handle, uint32_t length) {
+	payloadBytes += length;
+}
+
+static void traceHandler(const ESP8266Trace &trace) {
+	latencies.push_back((hostMicros() - enqueued[trace.id]) / 1000.0);
+	completed++;
+	if (trace.code != 200) {
+		failed++;
+	}
+}
+
+static void rxInterrupt() {
+	wifi.rxEvent();
+}
+
+// false when some request did not end or failed unexpectedly
+static boolean run(const Scenario &s) {
+	SimModem modem(_wifiSerial);
+	unsigned served = 0;
+	modem.route("*", 0, [&](const SimRequest &request, SimResponse &response) {
+		served++;
+		response.drop = s.dropEvery > 0 && served % s.dropEvery == 0;
+		response.body.assign(s.responseBytes, 'x');
+	});
+	hostDebugOut = NULL;
+
+	std::string post(s.postBytes, 'p');
+	char *postData = s.postBytes > 0 && s.postBytes <= ESP8266_CIPSEND_MAX ? &post[0] : NULL;
+
+	wifi.setMultiplex(s.multiplex);
+	wifi.setPipelining(s.pipelining);
+	if (s.transparent) {
+		wifi.setTransparent(hostNames[0], 80);
+	}
+	wifi.setBatching(s.batching);
+	wifi.hardReset();
+	wifi.begin();
+	wifi.setOnDataRecived(dataHandler);
+	wifi.setOnTrace(traceHandler);
+	if (s.streaming) {
+		wifi.setOnBodyChunk(chunkHandler);
+		wifi.setOnBodyEnd(endHandler);
+	}
+	// every body overwrites the same file
+	HostFileSink sink(P_tmpdir "/esp8266_bench.bin");
+	if (s.stored) {
+		wifi.setSink(&sink);
+		wifi.setOnBodyStored(storedHandler);
+	}
+	wifi.connect("ssid", "pwd");
+	while (!wifi.isConnected() && hostMicros() < 60000000ull) {
+		wifi.update();
+	}
+
+	if (s.rxInterruptUs > 0) {
+		hostTimerInterrupt(rxInterrupt, s.rxInterruptUs);
+	}
+	uint64_t start = hostMicros();
+	uint64_t updateNanos = 0;
+	uint64_t updateCycles = 0;
+	uint64_t updateNanosMax = 0;
+	unsigned long updates = 0;
+	unsigned issued = 0;
+	while (completed < s.requests && hostMicros() - start < BENCH_LIMIT_S * 1000000ull) {
+		boolean accepted = false;
+		if (issued < s.requests) {
+			accepted = s.postBytes > ESP8266_CIPSEND_MAX
+				? wifi.sendHttpRequestFrom(hostNames[issued % s.hosts], 80, (char *)s.method, "/item", s.postBytes, producer)
+				: wifi.sendHttpRequest(hostNames[issued % s.hosts], 80, (char *)s.method, "/item", postData);
+		}
+		if (accepted) {
+			enqueued[wifi.getLastRequestId()] = hostMicros();
+			payloadBytes += s.postBytes;
+			issued++;
+		}
+		uint64_t w = wallNanos();
+		uint64_t c = cycles();
+		wifi.update();
+		c = cycles() - c;
+		w = wallNanos() - w;
+		updateNanos += w;
+		updateCycles += c;
+		updateNanosMax = std::max(updateNanosMax, w);
+		updates++;
+		if (s.stallMs > 0) {
+			delay(s.stallMs);
+		}
+	}
+	double seconds = (hostMicros() - start) / 1e6;
+	unsigned dropped = s.dropEvery > 0 ? s.requests / s.dropEvery : 0;
+	boolean ok = completed == s.requests && (s.lossy || failed <= dropped);
+
+	printf("    {\"name\": \"%s\", \"requests\": %u, \"completed\": %u, \"failed\": %u, "
+		"\"virtual_s\": %.3f, \"requests_per_s\": %.2f, \"payload_bytes_per_s\": %.0f, "
+		"\"latency_p50_ms\": %.1f, \"latency_p99_ms\": %.1f, "
+		"\"updates\": %lu, \"update_ns_mean\": %.0f, \"update_ns_max\": %llu, \"update_cycles_mean\": %.0f, "
+		"\"buffer_peak\": %u, \"fifo_overruns\": %lu, \"rx_overruns\": %lu, \"rx_peak\": %u, \"ok\": %s}",
+		s.name, s.requests, completed, failed,
+		seconds, completed / seconds, payloadBytes / seconds,
+		percentile(latencies, 0.50), percentile(latencies, 0.99),
+		updates, (double)updateNanos / updates, (unsigned long long)updateNanosMax, (double)updateCycles / updates,
+		wifi.getBufferPeak(), _wifiSerial.overruns(), wifi.getRxOverruns(), wifi.getRxPeak(), ok ? "true" : "false");
+	return ok;
+}
+
+int main(int argc, char *argv[]) {
+	boolean first = true;
+	int failedScenarios = 0;
+	printf("{\n  \"revision\": \"%s\",\n  \"ram_bytes\": %u,\n  \"scenarios\": [\n", BENCH_REVISION, (unsigned)sizeof(ESP8266));
+	for (size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++) {
+		boolean selected = argc < 2;
+		for (int a = 1; a < argc; a++) {
+			selected = selected || strcmp(argv[a], scenarios[i].name) == 0;
+		}
+		if (!selected) {
+			continue;
+		}
+		if (!first) {
+			printf(",\n");
+		}
+		first = false;
+		fflush(stdout);
+		// library and virtual clock are global, every scenario starts from scratch
+		pid_t pid = fork();
+		if (pid == 0) {
+			boolean ok = run(scenarios[i]);
+			fflush(stdout);
+			_exit(ok ? 0 : 1);
+		}
+		int status;
+		waitpid(pid, &status, 0);
+		if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+			failedScenarios++;
+		}
+	}
+	printf("\n  ]\n}\n");
+	return failedScenarios;
+}
@@ -0,0 +1,132 @@
+/*
+* Host version of example/example.ino
+*
+* Runs the unmodified library against the simulated ESP8266 (SimModem) and a
+* local HTTP stand-in for example.com, printing every response together with
+* the virtual time it arrived at.
+*
+* usage: host_example [-t seconds] [-b modem_baud] [-s switch_baud] [-S saved_baud] [-q]
+*/
+
+#include <ESP8266.h>
+#include "SimModem.h"
+
+#include <unistd.h>
+
+unsigned long currentTimestamp = 0;
+unsigned long httpTimestamp = 0;
+
+void dataprocessHandler(int code, char data[]) {
+	printf("[%8.3f] response %d: %s\n", hostMicros() / 1e6, code, data);
+}
+
+void traceHandler(const ESP8266Trace &trace) {
+	printf("[%8.3f] trace #%u code %d:", hostMicros() / 1e6, trace.id, trace.code);
+	for (uint8_t s = 0; s < TRACE_STAGES; s++) {
+		if (trace.stage[s] == TRACE_NONE) {
+			printf("      -");
+		}
+		else {
+			printf(" %6u", trace.stage[s]);
+		}
+	}
+	printf("\n");
+}
+
+void connectedHandler() {
+	printf("[%8.3f] connected\n", hostMicros() / 1e6);
+}
+
+void disconnectedHandler() {
+	printf("[%8.3f] disconnected\n", hostMicros() / 1e6);
+}
+
+class StdoutPrint : public Print
+{
+  public:
+	size_t write(uint8_t c) {
+		// println() ends lines with "\r\n"
+		if (c != '\r') {
+			fputc(c, stdout);
+		}
+		return 1;
+	}
+};
+
+int main(int argc, char *argv[]) {
+	unsigned long seconds = 120;
+	int opt;
+	SimModem modem(_wifiSerial);
+
+	while ((opt = getopt(argc, argv, "t:b:s:S:q")) != -1) {
+		switch (opt) {
+		case 't':
+			seconds = strtoul(optarg, NULL, 10);
+			break;
+		case 'b':
+			modem.config.baud = strtoul(optarg, NULL, 10);
+			break;
+		case 's':
+			wifi.setBaudRate(strtoul(optarg, NULL, 10));
+			break;
+		case 'S':
+			wifi.setBaudRate(strtoul(optarg, NULL, 10), true);
+			break;
+		case 'q':
+			hostDebugOut = NULL;
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-t seconds] [-b modem_baud] [-s switch_baud] [-S saved_baud] [-q]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	modem.route("example.com", 80, [](const SimRequest &request, SimResponse &response) {
+		response.headers = "Content-Type: application/json\r\n";
+		response.body = "{\"method\":\"" + request.method + "\",\"url\":\"" + request.url
+			+ "\",\"received\":" + std::to_string(request.body.size()) + "}";
+	});
+
+	wifi.hardReset();
+	wifi.begin();
+	wifi.setOnWifiConnected(connectedHandler);
+	wifi.setOnWifiDisconnected(disconnectedHandler);
+	wifi.setOnDataRecived(dataprocessHandler);
+	wifi.setOnTrace(traceHandler);
+	wifi.connect("ssid", "pwd");
+
+	while (hostMicros() < (uint64_t)seconds * 1000000) {
+		currentTimestamp = millis();
+		wifi.update();
+
+		if (currentTimestamp - httpTimestamp > 20000) {
+			httpTimestamp = currentTimestamp;
+			wifi.sendHttpRequest("example.com", 80, "GET", "/subdir/index.html", "data sended with request", "url_query_data");
+		}
+	}
+
+	printf("modem: %lu commands, %lu connects, %lu lookups, %lu requests, %lu responses, %lu/%lu bytes rx/tx, %lu garbled\n",
+		modem.stats.commands, modem.stats.connects, modem.stats.lookups, modem.stats.requests, modem.stats.responses,
+		modem.stats.bytesToHost, modem.stats.bytesFromHost, modem.stats.garbled);
+	printf("host serial: %lu fifo overruns, %lu baud, %lu B/s measured\n", _wifiSerial.overruns(), wifi.getBaudRate(), wifi.getByteRate());
+
+	static const char *stages[TRACE_STAGES] = { "queue", "connect", "prompt", "send", "server", "recive", "total" };
+	printf("latency [ms]");
+	for (uint8_t b = 0; b < TRACE_BUCKETS; b++) {
+		printf(b < TRACE_BUCKETS - 1 ? " <%5u" : "   more", wifi.getLatencyLimit(b));
+	}
+	printf("\n");
+	for (uint8_t s = 0; s < TRACE_STAGES; s++) {
+		printf("%-12s", stages[s]);
+		for (uint8_t b = 0; b < TRACE_BUCKETS; b++) {
+			printf(" %6u", wifi.getLatencyCount(s, b));
+		}
+		printf("\n");
+	}
+
+	// report goes through Print like on the board
+	StdoutPrint out;
+	printf("ram [bytes]\n");
+	wifi.printRamReport(out);
+	return 0;
+}
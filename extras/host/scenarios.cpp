@@ -0,0 +1,1128 @@
+/*
+* Functional scenarios of the ESP8266 HTTP Client library against the
+* simulated ESP8266
+*
+* Every scenario runs the real state machine in its own process (fresh library
+* and virtual clock, as in bench) and checks what handlers report. Failed
+* checks are printed with their line, exit status is number of failed
+* scenarios.
+*
+* usage: scenarios [scenario...]    (all scenarios when none given)
+*/
+
+#include <ESP8266.h>
+#include <ESP8266Pool.h>
+#include "SimModem.h"
+#include "HostFdTransport.h"
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// virtual time limit of one wait
+#define SCENARIO_LIMIT_S 120
+
+static unsigned failures;
+
+#define CHECK(condition) check(condition, #condition, __LINE__)
+
+static void check(bool ok, const char *what, int line) {
+	if (!ok) {
+		printf("    line %d: %s\n", line, what);
+		failures++;
+	}
+}
+
+// update until condition holds, false when virtual time limit passed first
+template <class Condition, class Update>
+static bool waitFor(Condition condition, Update update) {
+	uint64_t start = hostMicros();
+	while (!condition()) {
+		if (hostMicros() - start > SCENARIO_LIMIT_S * 1000000ull) {
+			return false;
+		}
+		update();
+	}
+	return true;
+}
+
+template <class Condition>
+static bool waitFor(Condition condition) {
+	return waitFor(condition, [] { wifi.update(); });
+}
+
+static void start(boolean multiplex) {
+	hostDebugOut = NULL;
+	wifi.setMultiplex(multiplex);
+	wifi.hardReset();
+	wifi.begin();
+	wifi.connect("ssid", "pwd");
+	CHECK(waitFor([] { return wifi.isConnected(); }));
+}
+
+// values reported by json extractors, "<request id> <path> <type> <value>"
+static std::vector<std::string> jsonValues;
+static std::vector<int> jsonEnds;
+
+static void jsonValue(uint8_t path, const char value[], uint8_t type) {
+	jsonValues.push_back(std::to_string(wifi.getResponseRequestId()) + " " + std::to_string(path) + " "
+		+ std::to_string(type) + " " + value);
+}
+
+static void jsonEnd(int code) {
+	jsonEnds.push_back(code);
+}
+
+// values split across +IPD frames, escapes, [*] paths, truncation and extractor per link
+static void json() {
+	SimModem modem(_wifiSerial);
+	modem.config.ipdChunk = 7;
+	modem.route("*", 0, [](const SimRequest &request, SimResponse &response) {
+		if (request.url == "/a") {
+			response.body = "{\"data\": {\"temp\": -21.5e1, \"name\": \"a\\\"b\\\\c\\u0041\\n\"}, "
+				"\"list\": [{\"name\": \"x\"}, {\"id\": 1}, {\"name\": \"y\"}], \"ok\": true, \"none\": null}";
+		}
+		else {
+			response.body = "{\"data\": {\"name\": \"0123456789abcdefghijklmnopqrstuvwxyz\", \"temp\": 7}, \"ok\": false}";
+		}
+	});
+	start(true);
+	static const char * const paths[] = { "data.temp", "data.name", "list[*].name", "ok" };
+	ESP8266Json extractors[2];
+	for (uint8_t i = 0; i < 2; i++) {
+		extractors[i].setPaths(paths, 4);
+		extractors[i].setOnValue(jsonValue);
+	}
+	wifi.setJsonExtractor(extractors, 2);
+	wifi.setOnBodyEnd(jsonEnd);
+
+	// both in flight at once, each on its own link with its own extractor
+	CHECK(wifi.sendHttpRequest("a.sim", 80, METHOD_GET, "/a"));
+	uint8_t a = wifi.getLastRequestId();
+	CHECK(wifi.sendHttpRequest("b.sim", 80, METHOD_GET, "/b"));
+	uint8_t b = wifi.getLastRequestId();
+	CHECK(waitFor([] { return jsonEnds.size() == 2; }));
+	CHECK(jsonEnds[0] == 200 && jsonEnds[1] == 200);
+
+	std::string ra = std::to_string(a) + " ", rb = std::to_string(b) + " ";
+	std::vector<std::string> forA, forB;
+	for (size_t i = 0; i < jsonValues.size(); i++) {
+		if (jsonValues[i].compare(0, ra.size(), ra) == 0) {
+			forA.push_back(jsonValues[i].substr(ra.size()));
+		}
+		else if (jsonValues[i].compare(0, rb.size(), rb) == 0) {
+			forB.push_back(jsonValues[i].substr(rb.size()));
+		}
+	}
+	CHECK(forA.size() == 5 && forB.size() == 3);
+	if (forA.size() == 5) {
+		CHECK(forA[0] == "0 1 -21.5e1");
+		CHECK(forA[1] == "1 0 a\"b\\cA\n");
+		CHECK(forA[2] == "2 0 x");
+		CHECK(forA[3] == "2 0 y");
+		CHECK(forA[4] == "3 2 true");
+	}
+	if (forB.size() == 3) {
+		// value buffer keeps ESP8266_JSON_VALUE - 1 chars
+		CHECK(forB[0] == "1 0 " + std::string("0123456789abcdefghijklmnopqrstuvwxyz").substr(0, ESP8266_JSON_VALUE - 1));
+		CHECK(forB[1] == "0 1 7");
+		CHECK(forB[2] == "3 2 false");
+	}
+}
+
+static ESP8266Pool pool;
+// "<module> <request id> <code>" of every response, module told by getCurrentModule()
+static std::vector<std::string> poolResponses;
+
+static void poolData(int code, char data[]) {
+	uint8_t m = pool.getCurrentModule();
+	poolResponses.push_back(std::to_string(m) + " " + std::to_string(pool.module(m).getResponseRequestId()) + " "
+		+ std::to_string(code));
+}
+
+// sends request through pool, returns "<module> <request id>" it went to
+static std::string poolSend() {
+	if (!pool.sendHttpRequest("p.sim", 80, METHOD_GET, "/")) {
+		return "none";
+	}
+	return std::to_string(pool.getLastModule()) + " " + std::to_string(pool.getLastRequestId());
+}
+
+// request with id of given poolSend() result got response through given module
+static bool poolAnswered(const std::string &sent, uint8_t module) {
+	std::string expected = std::to_string(module) + sent.substr(sent.find(' ')) + " 200";
+	return std::find(poolResponses.begin(), poolResponses.end(), expected) != poolResponses.end();
+}
+
+// least pending module is chosen, disconnected or resetting one is skipped, responses
+// are handled with getCurrentModule() of module they came through, requests waiting
+// in module without wifi move to connected one and keep their ids
+static void poolModules() {
+	hostDebugOut = NULL;
+	SimModem modem0(Serial1), modem1(Serial2);
+	modem0.config.resetPin = 16;
+	modem1.config.resetPin = 17;
+	SimHandler ok = [](const SimRequest &request, SimResponse &response) { response.body = "ok"; };
+	modem0.route("*", 0, ok);
+	modem1.route("*", 0, ok);
+	static ESP8266 wifi0(Serial1, 16), wifi1(Serial2, 17);
+	ESP8266 *modules[] = { &wifi0, &wifi1 };
+	for (uint8_t i = 0; i < 2; i++) {
+		modules[i]->hardReset();
+		modules[i]->begin();
+		modules[i]->setOnDataRecived(poolData);
+		modules[i]->connect("ssid", "pwd");
+		CHECK(pool.add(*modules[i]));
+	}
+	auto update = [] { pool.update(); };
+	CHECK(waitFor([] { return pool.getReadyCount() == 2; }, update));
+
+	// ties go round robin, otherwise fewest pending requests wins
+	std::vector<std::string> sent;
+	sent.push_back(poolSend());
+	sent.push_back(poolSend());
+	sent.push_back(poolSend());
+	CHECK(sent[0].compare(0, 2, "0 ") == 0);
+	CHECK(sent[1].compare(0, 2, "1 ") == 0);
+	CHECK(sent[2].compare(0, 2, "0 ") == 0);
+	CHECK(wifi0.getPendingRequests() == 2 && wifi1.getPendingRequests() == 1);
+	sent.push_back(poolSend());
+	CHECK(sent[3].compare(0, 2, "1 ") == 0);
+	CHECK(waitFor([] { return poolResponses.size() == 4; }, update));
+	for (size_t i = 0; i < sent.size(); i++) {
+		CHECK(std::find(poolResponses.begin(), poolResponses.end(), sent[i] + " 200") != poolResponses.end());
+	}
+
+	// disconnected module gets nothing
+	wifi0.disconnect();
+	CHECK(waitFor([] { return pool.getReadyCount() == 1; }, update));
+	for (uint8_t i = 0; i < 3; i++) {
+		std::string s = poolSend();
+		CHECK(s.compare(0, 2, "1 ") == 0);
+	}
+	CHECK(waitFor([] { return poolResponses.size() == 7; }, update));
+	wifi0.connect("ssid", "pwd");
+	CHECK(waitFor([] { return pool.getReadyCount() == 2; }, update));
+
+	// nor does module being reset
+	wifi1.hardReset();
+	CHECK(!wifi1.isConnected());
+	for (uint8_t i = 0; i < 3; i++) {
+		std::string s = poolSend();
+		CHECK(s.compare(0, 2, "0 ") == 0);
+	}
+	CHECK(waitFor([] { return poolResponses.size() == 10; }, update));
+	CHECK(pool.getCurrentModule() == MODULE_NONE);
+
+	// module reset before it sent queued request, request goes through the other one
+	wifi1.begin();
+	wifi1.connect("ssid", "pwd");
+	CHECK(waitFor([] { return pool.getReadyCount() == 2; }, update));
+	std::string a = poolSend(), b = poolSend();
+	CHECK(a[0] != b[0] && a[0] != 'n' && b[0] != 'n');
+	wifi1.hardReset();
+	CHECK(waitFor([] { return poolResponses.size() == 12; }, update));
+	CHECK(poolAnswered(a, 0) && poolAnswered(b, 0));
+	CHECK(wifi1.getPendingRequests() == 0);
+
+	// no module connected, requests wait in modules and go out through first one connected
+	wifi0.disconnect();
+	CHECK(waitFor([] { return pool.getReadyCount() == 0; }, update));
+	std::vector<std::string> waiting;
+	for (uint8_t i = 0; i < 3; i++) {
+		waiting.push_back(poolSend());
+		CHECK(waiting[i] != "none");
+	}
+	CHECK(wifi1.getPendingRequests() > 0);
+	wifi0.connect("ssid", "pwd");
+	CHECK(waitFor([] { return poolResponses.size() == 15; }, update));
+	for (uint8_t i = 0; i < 3; i++) {
+		CHECK(poolAnswered(waiting[i], 0));
+	}
+	for (size_t i = 0; i < poolResponses.size(); i++) {
+		CHECK(poolResponses[i].substr(poolResponses[i].size() - 4) == " 200");
+	}
+}
+
+static char liveHost[] = "live.sim";
+static unsigned breakerOk, breakerUnavailable, breakerTraced;
+
+// request failed by open breaker is sent again to host which works, from the handler
+static void breakerData(int code, char data[]) {
+	if (code == HTTP_CODE_UNAVAILABLE) {
+		breakerUnavailable++;
+		CHECK(wifi.sendHttpRequest(liveHost, 80, METHOD_GET, "/"));
+	}
+	else if (code == 200) {
+		breakerOk++;
+	}
+}
+
+static void breakerTrace(const ESP8266Trace &trace) {
+	if (trace.code == HTTP_CODE_UNAVAILABLE) {
+		CHECK(trace.link == LINK_NONE);
+		CHECK(trace.stage[TRACE_TOTAL] == trace.stage[TRACE_QUEUE]);
+		breakerTraced++;
+	}
+}
+
+// requests of host with open circuit breaker end with HTTP_CODE_UNAVAILABLE and trace
+// record, handler may send new requests then
+static void breaker() {
+	SimModem modem(_wifiSerial);
+	modem.route(liveHost, 80, [](const SimRequest &request, SimResponse &response) { response.body = "ok"; });
+	start(false);
+	wifi.setOnDataRecived(breakerData);
+	wifi.setOnTrace(breakerTrace);
+	static char deadHost[] = "dead.sim";
+	// tried again after every failure until breaker opens
+	CHECK(wifi.sendHttpRequest(deadHost, 80, METHOD_GET, "/"));
+	CHECK(waitFor([] { return breakerUnavailable == 1; }));
+	CHECK(wifi.getHostFailures(deadHost, 80) == ESP8266_BREAKER_FAILURES);
+
+	// all queued at once, failed in one walk of the queue
+	for (uint8_t i = 0; i < 3; i++) {
+		CHECK(wifi.sendHttpRequest(deadHost, 80, METHOD_GET, "/"));
+	}
+	CHECK(waitFor([] { return breakerOk == 4; }));
+	CHECK(breakerUnavailable == 4 && breakerTraced == 4);
+}
+
+// server side "<url> <If-None-Match>" and handler side "<code> <body>" of every request
+static std::vector<std::string> cacheRequests, cacheResponses;
+
+static void cacheData(int code, char data[]) {
+	cacheResponses.push_back(std::to_string(code) + " " + std::string(data, wifi.getResponseLength()));
+}
+
+static void cacheGet(const char *url) {
+	size_t count = cacheResponses.size();
+	CHECK(wifi.sendHttpRequest("c.sim", 80, METHOD_GET, (char *)url));
+	CHECK(waitFor([count] { return cacheResponses.size() == count + 1; }));
+}
+
+// ETag sent back as If-None-Match, body of 304 replayed from store, least recently used
+// entry replaced and urls with colliding 16 bit key kept apart
+static void cache() {
+	SimModem modem(_wifiSerial);
+	modem.route("*", 0, [](const SimRequest &request, SimResponse &response) {
+		std::string etag = "\"v1" + request.url + "\"";
+		cacheRequests.push_back(request.url + " " + request.header("If-None-Match"));
+		if (request.header("If-None-Match") == etag) {
+			response.status = 304;
+			response.reason = "Not Modified";
+			return;
+		}
+		response.headers = "ETag: " + etag + "\r\n";
+		response.body = "body " + request.url;
+	});
+	start(false);
+	static char stores[2][32];
+	static ESP8266Cache entries[2] = { { stores[0], sizeof(stores[0]) }, { stores[1], sizeof(stores[1]) } };
+	wifi.setCache(entries, 2);
+	wifi.setOnDataRecived(cacheData);
+
+	static const char * const urls[] = { "/a", "/a", "/b", "/a", "/c", "/b", "/c" };
+	static const char * const validators[] = { "", "\"v1/a\"", "", "\"v1/a\"", "", "", "\"v1/c\"" };
+	for (uint8_t i = 0; i < 7; i++) {
+		cacheGet(urls[i]);
+	}
+	CHECK(cacheRequests.size() == 7 && cacheResponses.size() == 7);
+	for (size_t i = 0; i < cacheRequests.size() && i < 7; i++) {
+		CHECK(cacheRequests[i] == std::string(urls[i]) + " " + validators[i]);
+		CHECK(cacheResponses[i] == std::string(validators[i][0] != '\0' ? "304" : "200") + " body " + urls[i]);
+	}
+
+	// both urls have key 3172 on c.sim:80
+	cacheRequests.clear();
+	cacheResponses.clear();
+	cacheGet("/n2287");
+	cacheGet("/n5000");
+	cacheGet("/n2287");
+	cacheGet("/n5000");
+	CHECK(cacheRequests.size() == 4);
+	if (cacheRequests.size() == 4) {
+		CHECK(cacheRequests[0] == "/n2287 " && cacheRequests[1] == "/n5000 ");
+		CHECK(cacheRequests[2] == "/n2287 \"v1/n2287\"" && cacheRequests[3] == "/n5000 \"v1/n5000\"");
+	}
+	CHECK(cacheResponses.size() == 4 && cacheResponses[3] == "304 body /n5000");
+}
+
+// request bodies seen by server, "<request id> <code> <body>" seen by handler
+static std::vector<std::string> batchBodies, batchResponses;
+static boolean batchDrop;
+
+static void batchData(int code, char data[]) {
+	batchResponses.push_back(std::to_string(wifi.getResponseRequestId()) + " " + std::to_string(code) + " " + data);
+}
+
+// every POST of batch ends on its own, broken batch too, expired POST is left out and
+// ends with HTTP_CODE_EXPIRED
+static void batch() {
+	SimModem modem(_wifiSerial);
+	modem.route("*", 0, [](const SimRequest &request, SimResponse &response) {
+		if (request.method == "GET") {
+			// keeps the only connection busy while POSTs wait
+			response.latencyMs = 1000;
+			return;
+		}
+		batchBodies.push_back(request.body);
+		response.body = "ok";
+		response.drop = batchDrop;
+	});
+	start(false);
+	wifi.setBatching(BATCH_JSON, 256, 200);
+	wifi.setOnDataRecived(batchData);
+	static char host[] = "b.sim";
+
+	// second POST expires while waiting, batch goes without it
+	CHECK(wifi.sendHttpRequest(host, 80, METHOD_GET, "/"));
+	CHECK(wifi.sendHttpRequest(host, 80, METHOD_POST, "/in", "1"));
+	uint8_t first = wifi.getLastRequestId();
+	CHECK(wifi.sendHttpRequest(host, 80, METHOD_POST, "/in", "2", NULL, PRIORITY_NORMAL, 500));
+	uint8_t second = wifi.getLastRequestId();
+	CHECK(wifi.sendHttpRequest(host, 80, METHOD_POST, "/in", "3"));
+	uint8_t third = wifi.getLastRequestId();
+	CHECK(waitFor([] { return batchResponses.size() == 4; }));
+	CHECK(batchBodies.size() == 1 && batchBodies[0] == "[1,3]");
+	CHECK(wifi.getDroppedRequests() == 1);
+	CHECK(batchResponses.size() == 4 && batchResponses[1] == std::to_string(second) + " " + std::to_string(HTTP_CODE_EXPIRED) + " "
+		&& batchResponses[2] == std::to_string(first) + " 200 ok" && batchResponses[3] == std::to_string(third) + " 200 ok");
+
+	// server never answers, every POST of batch gets HTTP_CODE_BROKEN and empty body
+	batchDrop = true;
+	batchResponses.clear();
+	uint8_t ids[3];
+	for (uint8_t i = 0; i < 3; i++) {
+		CHECK(wifi.sendHttpRequest(host, 80, METHOD_POST, "/in", "4"));
+		ids[i] = wifi.getLastRequestId();
+	}
+	CHECK(waitFor([] { return batchResponses.size() == 3; }));
+	CHECK(batchBodies.size() == 2 && batchBodies[1] == "[4,4,4]");
+	for (uint8_t i = 0; i < 3 && i < batchResponses.size(); i++) {
+		CHECK(batchResponses[i] == std::to_string(ids[i]) + " " + std::to_string(HTTP_CODE_BROKEN) + " ");
+	}
+}
+
+static std::vector<std::string> transportResponses;
+
+static void transportData(int code, char data[]) {
+	transportResponses.push_back(std::to_string(code) + " " + data);
+}
+
+// client over one end of socketpair, other end is wired to simulated module on Serial3,
+// module output is read in blocks
+static void transport() {
+	hostDebugOut = NULL;
+	SimModem modem(Serial3);
+	modem.route("*", 0, [](const SimRequest &request, SimResponse &response) {
+		response.body = "body " + request.url + std::string(200, 'x');
+	});
+	int fds[2];
+	CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+	static HostFdTransport port(fds[0]), wire(fds[1]);
+	Serial3.begin(115200);
+	static ESP8266Client<ESP8266Transport> client(port, 18);
+	// moves bytes between socket and port of module, module output goes in blocks of
+	// 32 bytes or when line is idle for 1 ms, like DMA UART driver hands them over
+	auto update = [] {
+		static std::string block;
+		static uint64_t last;
+		client.update();
+		uint8_t data[64];
+		size_t n = wire.read(data, sizeof(data));
+		Serial3.write(data, n);
+		while (Serial3.available() > 0) {
+			block += (char)Serial3.read();
+			last = hostMicros();
+		}
+		if (block.size() >= 32 || (!block.empty() && hostMicros() - last > 1000)) {
+			wire.write((const uint8_t *)block.data(), block.size());
+			block.clear();
+		}
+	};
+	client.begin();
+	client.setOnDataRecived(transportData);
+	client.connect("ssid", "pwd");
+	CHECK(waitFor([] { return client.isConnected(); }, update));
+
+	static char host[] = "t.sim";
+	CHECK(client.sendHttpRequest(host, 80, METHOD_GET, "/1"));
+	CHECK(client.sendHttpRequest(host, 80, METHOD_GET, "/2"));
+	CHECK(waitFor([] { return transportResponses.size() == 2; }, update));
+	CHECK(transportResponses.size() == 2 && transportResponses[0] == "200 body /1" + std::string(200, 'x')
+		&& transportResponses[1] == "200 body /2" + std::string(200, 'x'));
+	CHECK(port.bytesRead > 400 && port.reads < port.bytesRead / 8);
+	CHECK(port.bytesWritten > 0);
+}
+
+// matcher of the client fed directly, byte by byte, bypassing the serial port
+class KeywordProbe : public ESP8266 {
+public:
+	KeywordProbe() : ESP8266(Serial3) {}
+
+	// offsets just past each match of keyword in chunks fed one after another
+	std::vector<size_t> matches(uint8_t keyword, std::vector<std::string> chunks, const char custom[] = NULL) {
+		std::vector<size_t> found;
+		customKeyword = custom;
+		uint8_t progress = 0;
+		size_t offset = 0;
+		for (size_t i = 0; i < chunks.size(); i++) {
+			for (size_t j = 0; j < chunks[i].size(); j++) {
+				offset++;
+				if (keywordStep(keyword, progress, chunks[i][j])) {
+					found.push_back(offset);
+				}
+			}
+		}
+		return found;
+	}
+
+	// latched result of response matcher for true and false keyword pair
+	uint8_t response(uint8_t trueKeyword, uint8_t falseKeyword, const std::string &input) {
+		setResponseTrueKeywords(trueKeyword, KEYWORD_NONE);
+		setResponseFalseKeywords(falseKeyword, KEYWORD_NONE);
+		keywordsReset();
+		for (size_t i = 0; i < input.size(); i++) {
+			keywordsMatch(input[i]);
+		}
+		return responseMatch;
+	}
+};
+
+// keywords split across reads and overlapping their own prefix
+static void keywords() {
+	KeywordProbe probe;
+	typedef std::vector<size_t> at;
+
+	// trailer split after every byte, and restarted inside a near miss
+	CHECK(probe.matches(KEYWORD_IPD_TRAILER, { "\r", "\n", "O", "K", "\r", "\n" }) == at({ 6 }));
+	CHECK(probe.matches(KEYWORD_IPD_TRAILER, { "\r\nOK\r", "\r\nOK\r\n" }) == at({ 11 }));
+	CHECK(probe.matches(KEYWORD_IPD_TRAILER, { "\r\nOK\r\nOK\r\n" }) == at({ 6 }));
+	CHECK(probe.matches(KEYWORD_IPD_TRAILER, { "\r\r\nOK", "\r\n\r\nOK\r\n" }) == at({ 7, 13 }));
+
+	// "STATUS:" alone is no match, overlapping prefix keeps partial match
+	CHECK(probe.matches(KEYWORD_STATUS_3, { "STATUS:", "2\r\n" }).empty());
+	CHECK(probe.matches(KEYWORD_STATUS_3, { "STATUS:", "STATUS:3" }) == at({ 15 }));
+	CHECK(probe.matches(KEYWORD_STATUS_3, { "STATU", "STATUS:3" }) == at({ 13 }));
+	CHECK(probe.matches(KEYWORD_STATUS_3, { "STATUSTATUS", ":3" }) == at({ 13 }));
+
+	// keyword of sendATCommand() has no table, fallback computed in place
+	CHECK(probe.matches(KEYWORD_CUSTOM, { "aa", "aab", "ab" }, "aab") == at({ 5 }));
+	CHECK(probe.matches(KEYWORD_CUSTOM, { "abab", "abac" }, "ababac") == at({ 8 }));
+
+	// true keyword wins over false one seen before it, false alone latches false
+	CHECK(probe.response(KEYWORD_OK, KEYWORD_ERROR, "AT\r\n\r\nERROR\r\n\r\nOK\r\n") == SERIAL_RESPONSE_TRUE);
+	CHECK(probe.response(KEYWORD_OK, KEYWORD_ERROR, "AT\r\n\r\nERROR\r\n") == SERIAL_RESPONSE_FALSE);
+	CHECK(probe.response(KEYWORD_SEND_OK, KEYWORD_ERROR, "\nSEND \nSEND OK") == SERIAL_RESPONSE_TRUE);
+	CHECK(probe.response(KEYWORD_SEND_OK, KEYWORD_ERROR, "\nOK\r\n") == SERIAL_RESPONSE_PENDING);
+}
+
+static std::vector<std::string> baudResponses;
+
+static void baudData(int code, char data[]) {
+	baudResponses.push_back(std::to_string(code) + " " + data);
+}
+
+// board reset (begin()) and connection, then one request, true when response came
+static bool baudRun(ESP8266 &client) {
+	auto update = [&client] { client.update(); };
+	client.hardReset();
+	client.begin();
+	client.connect("ssid", "pwd");
+	if (!waitFor([&client] { return client.isConnected(); }, update)) {
+		return false;
+	}
+	size_t before = baudResponses.size();
+	static char host[] = "b.sim";
+	return client.sendHttpRequest(host, 80, METHOD_GET, "/")
+		&& waitFor([before] { return baudResponses.size() > before; }, update)
+		&& baudResponses.back() == "200 ok";
+}
+
+// rate is switched with AT+UART_CUR only, AT+CIOBAUD needs opt-in and begin() finds
+// module at its saved rate after board reset, refused or garbled rate is halved
+static void baud() {
+	hostDebugOut = NULL;
+	SimModem modem0(Serial), modem1(Serial1), modem2(Serial2), modem3(Serial3);
+	SimModem *modems[] = { &modem0, &modem1, &modem2, &modem3 };
+	static ESP8266 clients[] = { ESP8266(Serial, 2), ESP8266(Serial1, 16), ESP8266(Serial2, 17), ESP8266(Serial3, 18) };
+	static const uint8_t pins[] = { 2, 16, 17, 18 };
+	for (uint8_t i = 0; i < 4; i++) {
+		modems[i]->config.resetPin = pins[i];
+		modems[i]->route("*", 0, [](const SimRequest &request, SimResponse &response) { response.body = "ok"; });
+		clients[i].setOnDataRecived(baudData);
+	}
+
+	// old firmware without opt-in keeps default rate, also after board reset
+	clients[0].setBaudRate(921600);
+	CHECK(baudRun(clients[0]));
+	CHECK(clients[0].getBaudRate() == 115200 && modems[0]->config.baud == 115200);
+	CHECK(baudRun(clients[0]));
+	CHECK(clients[0].getBaudRate() == 115200);
+
+	// saved rate is looked for by begin()
+	clients[1].setBaudRate(921600, true);
+	CHECK(baudRun(clients[1]));
+	CHECK(clients[1].getBaudRate() == 921600 && modems[1]->config.baud == 921600);
+	CHECK(baudRun(clients[1]));
+	CHECK(clients[1].getBaudRate() == 921600);
+
+	// refused rates are halved right away
+	modems[2]->config.uartCur = true;
+	modems[2]->config.maxBaud = 230400;
+	clients[2].setBaudRate(921600);
+	CHECK(baudRun(clients[2]));
+	CHECK(clients[2].getBaudRate() == 230400);
+
+	// rate garbled by wiring is dropped after reset, next reset tries half of it
+	modems[3]->config.uartCur = true;
+	modems[3]->config.cleanBaud = 460800;
+	clients[3].setBaudRate(921600);
+	CHECK(baudRun(clients[3]));
+	CHECK(clients[3].getBaudRate() == 460800 && modems[3]->config.baud == 460800);
+}
+
+// "<request id> <code> <body>" seen by handler, "<request id> <code>" of unsent traced ones
+static std::vector<std::string> queueResponses, queueTraces;
+
+static void queueData(int code, char data[]) {
+	queueResponses.push_back(std::to_string(wifi.getResponseRequestId()) + " " + std::to_string(code) + " " + data);
+}
+
+static void queueTrace(const ESP8266Trace &trace) {
+	if (trace.link == LINK_NONE) {
+		queueTraces.push_back(std::to_string(trace.id) + " " + std::to_string(trace.code));
+	}
+}
+
+static bool queueHas(const std::string &response) {
+	return std::find(queueResponses.begin(), queueResponses.end(), response) != queueResponses.end();
+}
+
+// expired and dropped requests end with their own code and empty body after queue walk,
+// are traced and counted
+static void queueEnds() {
+	SimModem modem(_wifiSerial);
+	modem.route("*", 0, [](const SimRequest &request, SimResponse &response) {
+		// keeps the only connection busy while others wait
+		response.latencyMs = request.url == "/slow" ? 1000 : 0;
+		response.body = request.url;
+	});
+	start(false);
+	wifi.setOnDataRecived(queueData);
+	wifi.setOnTrace(queueTrace);
+	static char host[] = "q.sim";
+
+	// deadline passes while slow request is in flight, it is found on next queue walk
+	CHECK(wifi.sendHttpRequest(host, 80, METHOD_GET, "/slow"));
+	CHECK(wifi.sendHttpRequest(host, 80, METHOD_GET, "/late", NULL, NULL, PRIORITY_NORMAL, 300));
+	std::string late = std::to_string(wifi.getLastRequestId());
+	CHECK(waitFor([] { return queueResponses.size() == 2; }));
+	CHECK(queueHas(late + " " + std::to_string(HTTP_CODE_EXPIRED) + " "));
+	CHECK(wifi.getDroppedRequests() == 1);
+
+	// full queue, newest low priority request makes room for high one
+	CHECK(wifi.sendHttpRequest(host, 80, METHOD_GET, "/slow"));
+	static char *lows[] = { "/low0", "/low1", "/low2", "/low3" };
+	std::string lowIds[4];
+	for (uint8_t i = 0; i < 4; i++) {
+		CHECK(wifi.sendHttpRequest(host, 80, METHOD_GET, lows[i], NULL, NULL, PRIORITY_LOW));
+		lowIds[i] = std::to_string(wifi.getLastRequestId());
+	}
+	CHECK(wifi.getPendingRequests() == REQUEST_BUFFER);
+	CHECK(wifi.sendHttpRequest(host, 80, METHOD_GET, "/high", NULL, NULL, PRIORITY_HIGH));
+	std::string high = std::to_string(wifi.getLastRequestId());
+	CHECK(wifi.getDroppedRequests() == 2);
+	// handler is not called from sendHttpRequest(), update() does it
+	CHECK(queueResponses.size() == 2);
+	wifi.update();
+	CHECK(queueResponses.size() == 3 && queueResponses[2] == lowIds[3] + " " + std::to_string(HTTP_CODE_DROPPED) + " ");
+	CHECK(waitFor([] { return queueResponses.size() == 8; }));
+	CHECK(queueHas(high + " 200 /high") && queueHas(lowIds[0] + " 200 /low0") && queueHas(lowIds[2] + " 200 /low2"));
+	CHECK(!queueHas(lowIds[3] + " 200 /low3"));
+	CHECK(queueTraces.size() == 2 && queueTraces[0] == late + " " + std::to_string(HTTP_CODE_EXPIRED)
+		&& queueTraces[1] == lowIds[3] + " " + std::to_string(HTTP_CODE_DROPPED));
+}
+
+// urls in order server answered them, "<request id> <code> <body>" seen by handler
+static std::vector<std::string> pipelineUrls, pipelineResponses;
+static unsigned long pipelineFirstAt; // requests server had when first response came
+
+static void pipelineData(int code, char data[]) {
+	pipelineResponses.push_back(std::to_string(wifi.getResponseRequestId()) + " " + std::to_string(code) + " "
+		+ std::string(data, wifi.getResponseLength()));
+}
+
+static std::string pipelineBody(const std::string &url) {
+	// lengths differ, responses are split by Content-Length only
+	return url + std::string(10 * (url[2] - '0'), 'x');
+}
+
+// queued GETs go out at once over one connection, responses are split and handed over in
+// order, ones left without response when server closes are sent again
+static void pipelining() {
+	SimModem modem(_wifiSerial);
+	modem.route("*", 0, [&modem](const SimRequest &request, SimResponse &response) {
+		pipelineUrls.push_back(request.url + " " + std::to_string(modem.stats.connects));
+		// first one is slowest, the rest queue behind it on the socket
+		response.latencyMs = request.url[2] == '0' ? 300 : 20;
+		response.body = pipelineBody(request.url);
+		response.close = request.url == "/q1";
+	});
+	start(false);
+	wifi.setPipelining(4);
+	wifi.setOnDataRecived(pipelineData);
+	static char host[] = "p.sim";
+	static char *urls[2][4] = { { "/p0", "/p1", "/p2", "/p3" }, { "/q0", "/q1", "/q2", "/q3" } };
+
+	for (uint8_t burst = 0; burst < 2; burst++) {
+		pipelineResponses.clear();
+		std::string expected[4];
+		for (uint8_t i = 0; i < 4; i++) {
+			CHECK(wifi.sendHttpRequest(host, 80, METHOD_GET, urls[burst][i]));
+			expected[i] = std::to_string(wifi.getLastRequestId()) + " 200 " + pipelineBody(urls[burst][i]);
+		}
+		unsigned long before = modem.stats.requests;
+		CHECK(waitFor([&modem, before] {
+			if (pipelineResponses.empty()) {
+				pipelineFirstAt = modem.stats.requests - before;
+			}
+			return pipelineResponses.size() == 4;
+		}));
+		CHECK(pipelineResponses.size() == 4);
+		for (uint8_t i = 0; i < 4 && i < pipelineResponses.size(); i++) {
+			CHECK(pipelineResponses[i] == expected[i]);
+		}
+		// all were at server before slow first response came back, second burst loses
+		// /q2 and /q3 when server closes after /q1
+		CHECK(pipelineFirstAt == (burst == 0 ? 4u : 2u));
+	}
+	// "<url> <connections opened by then>" at server, first burst goes over one connection
+	// which is kept alive for second one, /q2 and /q3 are sent again over new connection
+	static const char * const served[] = { "/p0 1", "/p1 1", "/p2 1", "/p3 1", "/q0 1", "/q1 1", "/q2 2", "/q3 2" };
+	CHECK(pipelineUrls == std::vector<std::string>(served, served + 8));
+}
+
+// body bytes handed to chunk handler per request id, ids in order chunks came, end codes
+static std::map<uint8_t, std::string> demuxBodies;
+static std::vector<uint8_t> demuxOrder;
+static std::vector<int> demuxEnds;
+
+static void demuxChunk(const char data[], size_t length) {
+	uint8_t id = wifi.getResponseRequestId();
+	demuxBodies[id].append(data, length);
+	if (demuxOrder.empty() || demuxOrder.back() != id) {
+		demuxOrder.push_back(id);
+	}
+}
+
+static void demuxEnd(int code) {
+	demuxEnds.push_back(code);
+}
+
+static std::string demuxBody(const std::string &url) {
+	// frame headers, trailers and close notifications of module inside payload
+	std::string body;
+	for (uint8_t i = 0; i < 8; i++) {
+		body += url + " +IPD,1,5:\r\nOK\r\n2,CLOSED\r\nUnlink\r\n" + std::to_string(i);
+	}
+	return body;
+}
+
+// +IPD frames of three links interleaved, responses split in 13 byte frames, payload that
+// looks like frames and close notifications, server closes two links while third one
+// still sends, every byte goes to request of its link
+static void demux() {
+	SimModem modem(_wifiSerial);
+	modem.config.ipdChunk = 13;
+	modem.config.ipdGapUs = 2000;
+	modem.route("*", 0, [](const SimRequest &request, SimResponse &response) {
+		// later connections answer sooner, so all three respond at once
+		response.latencyMs = request.host == "a.sim" ? 160 : request.host == "b.sim" ? 100 : 40;
+		response.body = demuxBody(request.url);
+		response.close = request.host != "b.sim";
+	});
+	start(true);
+	wifi.setOnBodyChunk(demuxChunk);
+	wifi.setOnBodyEnd(demuxEnd);
+
+	static char *hosts[] = { "a.sim", "b.sim", "c.sim" };
+	static char *urls[] = { "/a", "/b", "/c" };
+	uint8_t ids[3];
+	for (uint8_t i = 0; i < 3; i++) {
+		CHECK(wifi.sendHttpRequest(hosts[i], 80, METHOD_GET, urls[i]));
+		ids[i] = wifi.getLastRequestId();
+	}
+	CHECK(waitFor([] { return demuxEnds.size() == 3; }));
+	CHECK(demuxEnds == std::vector<int>(3, 200));
+	for (uint8_t i = 0; i < 3; i++) {
+		CHECK(demuxBodies[ids[i]] == demuxBody(urls[i]));
+	}
+	// bodies came in turns, not one after another
+	CHECK(demuxOrder.size() > 6);
+}
+
+// "<host> <body> <passthroughs> <escapes>" seen by server, "<code> <body>" by handler
+static std::vector<std::string> transparentRequests, transparentResponses;
+
+static void transparentData(int code, char data[]) {
+	transparentResponses.push_back(std::to_string(code) + " " + std::string(data, wifi.getResponseLength()));
+}
+
+static void transparentSend(char host[], const char *body) {
+	size_t count = transparentResponses.size();
+	CHECK(wifi.sendHttpRequest(host, 80, METHOD_POST, "/in", (char *)body));
+	CHECK(waitFor([count] { return transparentResponses.size() == count + 1; }));
+}
+
+// requests to collector go raw after one AT+CIPSEND, "+++" in body is data, request for
+// another server and idle connection leave transparent transmission with "+++"
+static void transparent() {
+	SimModem modem(_wifiSerial);
+	modem.route("*", 0, [&modem](const SimRequest &request, SimResponse &response) {
+		transparentRequests.push_back(request.host + " " + request.body + " " + std::to_string(modem.stats.passthroughs)
+			+ " " + std::to_string(modem.stats.escapes));
+		response.body = "re " + request.body;
+	});
+	start(false);
+	static char collector[] = "t.sim", other[] = "o.sim";
+	wifi.setTransparent(collector, 80);
+	wifi.setKeepAliveTimeout(5000);
+	wifi.setOnDataRecived(transparentData);
+
+	transparentSend(collector, "1");
+	transparentSend(collector, "a+++b");
+	transparentSend(collector, "+++");
+	transparentSend(other, "2");
+	transparentSend(collector, "3");
+	// idle for keep-alive timeout
+	CHECK(waitFor([&modem] { return modem.stats.escapes == 2; }));
+	transparentSend(other, "4");
+
+	static const char * const requests[] = { "t.sim 1 1 0", "t.sim a+++b 1 0", "t.sim +++ 1 0", "o.sim 2 1 1",
+		"t.sim 3 2 1", "o.sim 4 2 2" };
+	CHECK(transparentRequests == std::vector<std::string>(requests, requests + 6));
+	static const char * const responses[] = { "200 re 1", "200 re a+++b", "200 re +++", "200 re 2", "200 re 3",
+		"200 re 4" };
+	CHECK(transparentResponses == std::vector<std::string>(responses, responses + 6));
+}
+
+// "<length> <body as produced or not>" seen by server, "<request id> <code> <body>" by
+// handler, "<request id> <code>" traced
+static std::vector<std::string> producerRequests, producerResponses, producerTraces;
+static size_t producerShortAt = (size_t)-1; // producer gives less than asked from this offset on
+static size_t producerAsked;                // most bytes asked for at once
+
+static char producerByte(size_t offset) {
+	return 'a' + (offset * 7 + offset / 26) % 26;
+}
+
+static std::string producerBodyOf(size_t length) {
+	std::string body;
+	for (size_t i = 0; i < length; i++) {
+		body += producerByte(i);
+	}
+	return body;
+}
+
+static size_t producerBody(char data[], size_t offset, size_t size) {
+	producerAsked = std::max(producerAsked, size);
+	for (size_t i = 0; i < size; i++) {
+		data[i] = producerByte(offset + i);
+	}
+	if (offset + size > producerShortAt) {
+		return producerShortAt > offset ? producerShortAt - offset : 0;
+	}
+	return size;
+}
+
+static void producerData(int code, char data[]) {
+	producerResponses.push_back(std::to_string(wifi.getResponseRequestId()) + " " + std::to_string(code) + " " + data);
+}
+
+static void producerTrace(const ESP8266Trace &trace) {
+	producerTraces.push_back(std::to_string(trace.id) + " " + std::to_string(trace.code));
+}
+
+static std::string producerSend(size_t length) {
+	static char host[] = "u.sim";
+	CHECK(wifi.sendHttpRequestFrom(host, 80, METHOD_POST, "/up", length, producerBody));
+	std::string id = std::to_string(wifi.getLastRequestId());
+	CHECK(waitFor([id] { return !producerTraces.empty() && producerTraces.back().compare(0, id.size() + 1, id + " ") == 0; }));
+	return id;
+}
+
+// body longer than CIPSEND frame is pulled from producer in tx buffer pieces and goes in
+// several frames, producer giving less than asked in second frame aborts request, the rest
+// of its frame is padded and next request goes over new connection
+static void producer() {
+	SimModem modem(_wifiSerial);
+	modem.route("*", 0, [](const SimRequest &request, SimResponse &response) {
+		boolean same = true;
+		for (size_t i = 0; i < request.body.size(); i++) {
+			same = same && request.body[i] == producerByte(i);
+		}
+		producerRequests.push_back(std::to_string(request.body.size()) + (same ? " same" : " differs"));
+		response.body = "got " + std::to_string(request.body.size());
+	});
+	start(false);
+	wifi.setOnDataRecived(producerData);
+	wifi.setOnTrace(producerTrace);
+
+	unsigned long sends = modem.stats.sends;
+	std::string id = producerSend(5000);
+	CHECK(modem.stats.sends - sends == 3);
+	CHECK(producerTraces.back() == id + " 200" && producerResponses.back() == id + " 200 got 5000");
+	CHECK(producerAsked <= ESP8266_TX_BUFFER);
+
+	producerShortAt = 3000;
+	sends = modem.stats.sends;
+	size_t responses = producerResponses.size();
+	id = producerSend(5000);
+	CHECK(producerTraces.back() == id + " " + std::to_string(HTTP_CODE_BROKEN));
+
+	producerShortAt = (size_t)-1;
+	id = producerSend(3000);
+	CHECK(producerResponses.size() == responses + 1 && producerResponses.back() == id + " 200 got 3000");
+	// two frames of aborted request, second one padded, and two of next request
+	CHECK(modem.stats.sends - sends == 4);
+	CHECK(modem.stats.connects == 2);
+	static const char * const requests[] = { "5000 same", "3000 same" };
+	CHECK(producerRequests == std::vector<std::string>(requests, requests + 2));
+}
+
+static std::string ringBody;
+static std::vector<int> ringEnds;
+static boolean ringSection;        // sketch has interrupts disabled
+static unsigned ringTicks, ringTicksInSection;
+
+static void ringChunk(const char data[], size_t length) {
+	ringBody.append(data, length);
+}
+
+static void ringEnd(int code) {
+	ringEnds.push_back(code);
+}
+
+static void ringInterrupt() {
+	ringTicks++;
+	if (ringSection) {
+		ringTicksInSection++;
+	}
+	wifi.rxEvent();
+}
+
+// one GET of 3000 byte body with timer interrupt every isrUs calling rxEvent(), loop()
+// is busy for stallMs after every update(), sectionUs of it with interrupts disabled
+static void ringGet(unsigned stallMs, unsigned sectionUs, uint32_t isrUs) {
+	static char host[] = "r.sim";
+	static unsigned stall, section;
+	stall = stallMs;
+	section = sectionUs;
+	ringBody.clear();
+	size_t ends = ringEnds.size();
+	unsigned long overruns = _wifiSerial.overruns();
+	hostTimerInterrupt(ringInterrupt, isrUs);
+	CHECK(wifi.sendHttpRequest(host, 80, METHOD_GET, "/"));
+	CHECK(waitFor([ends] { return ringEnds.size() > ends; }, [] {
+		wifi.update();
+		if (section > 0) {
+			noInterrupts();
+			ringSection = true;
+			delayMicroseconds(section);
+			ringSection = false;
+			interrupts();
+		}
+		delay(stall);
+	}));
+	hostTimerInterrupt(NULL, 0);
+	CHECK(ringEnds.size() == ends + 1 && ringEnds.back() == 200);
+	CHECK(ringBody.size() == 3000 && ringBody == producerBodyOf(3000));
+	CHECK(_wifiSerial.overruns() == overruns);
+}
+
+// bytes are moved to receive ring by timer interrupt while loop() is busy, interrupt also
+// comes in the middle of update() and must not run inside rxEvent() of client, one due
+// while sketch has interrupts disabled waits for interrupts(), body comes whole and serial
+// port never overflows
+static void ring() {
+	SimModem modem(_wifiSerial);
+	modem.route("*", 0, [](const SimRequest &request, SimResponse &response) {
+		response.body = producerBodyOf(3000);
+	});
+	start(false);
+	wifi.setOnBodyChunk(ringChunk);
+	wifi.setOnBodyEnd(ringEnd);
+
+	// 10 ms of 115200 baud is more than serial port holds
+	ringGet(10, 0, 1000);
+	CHECK(wifi.getRxPeak() == ESP8266_RX_RING);
+	// interrupt comes in the middle of update(), also while bytes are read from serial port
+	hostSetReadCost(5);
+	ringGet(0, 0, 100);
+	hostSetReadCost(0);
+	// ticks due in 2 ms with interrupts disabled run as one after them, serial port holds
+	// what comes meanwhile
+	ringTicks = 0;
+	ringGet(5, 2000, 1000);
+	CHECK(ringTicks > 0 && ringTicksInSection == 0);
+}
+
+// storage in memory, refuses first offer of every fourth block and stays busy for finalMs
+// after first offer of last block
+class MemorySink : public ESP8266Sink {
+public:
+	std::string data;
+	std::vector<uint16_t> blocks;   // lengths of written blocks
+	std::vector<std::string> log;   // "open <length>", "close <complete>"
+	uint32_t length;
+	unsigned long finalMs;
+	uint64_t busyUntil;
+	unsigned offers;
+
+	uint16_t open(uint8_t requestId, uint32_t _length) {
+		data.clear();
+		blocks.clear();
+		length = _length;
+		busyUntil = 0;
+		offers = 0;
+		log.push_back("open " + std::to_string(_length));
+		return requestId;
+	}
+
+	boolean write(uint32_t offset, const uint8_t block[], uint16_t size) {
+		offers++;
+		if (offset + size == length && busyUntil == 0) {
+			busyUntil = hostMicros() + (uint64_t)finalMs * 1000;
+		}
+		if (hostMicros() < busyUntil || (offset + size < length && offers % 4 == 1)) {
+			return false;
+		}
+		CHECK(offset == data.size());
+		data.append((const char *)block, size);
+		blocks.push_back(size);
+		return true;
+	}
+
+	void close(boolean complete) {
+		log.push_back(std::string("close ") + (complete ? "1" : "0"));
+	}
+};
+
+static MemorySink memorySink;
+// "<code> <handle> <length>" of stored bodies, "<code> <body>" of ones that fit buffer
+static std::vector<std::string> sinkStored, sinkResponses;
+
+static void sinkStoredData(int code, uint16_t handle, uint32_t length) {
+	sinkStored.push_back(std::to_string(code) + " " + std::to_string(handle) + " " + std::to_string(length));
+}
+
+static void sinkData(int code, char data[]) {
+	sinkResponses.push_back(std::to_string(code) + " " + data);
+}
+
+static void sinkGet(const char *url) {
+	static char host[] = "s.sim";
+	size_t count = sinkStored.size() + sinkResponses.size();
+	CHECK(wifi.sendHttpRequest(host, 80, METHOD_GET, (char *)url));
+	CHECK(waitFor([count] { return sinkStored.size() + sinkResponses.size() == count + 1; }));
+}
+
+// body bigger than buffer goes to sink in blocks, refused block is offered again while
+// module output waits, last block is waited for up to ESP8266_SINK_TIMEOUT, body that fits
+// buffer goes to data handler
+static void sinkSpill() {
+	SimModem modem(_wifiSerial);
+	modem.route("*", 0, [](const SimRequest &request, SimResponse &response) {
+		response.body = request.url == "/small" ? "small" : producerBodyOf(3000);
+	});
+	start(false);
+	wifi.setSink(&memorySink);
+	wifi.setOnBodyStored(sinkStoredData);
+	wifi.setOnDataRecived(sinkData);
+
+	// last block stored after 300 ms, body is complete
+	memorySink.finalMs = 300;
+	sinkGet("/big");
+	std::string id = std::to_string(wifi.getLastRequestId());
+	CHECK(sinkStored.size() == 1 && sinkStored.back() == "200 " + id + " 3000");
+	CHECK(memorySink.data == producerBodyOf(3000));
+	CHECK(memorySink.blocks.size() == (3000 + ESP8266_SINK_BLOCK - 1) / ESP8266_SINK_BLOCK);
+	for (size_t i = 0; i + 1 < memorySink.blocks.size(); i++) {
+		CHECK(memorySink.blocks[i] == ESP8266_SINK_BLOCK);
+	}
+	CHECK(memorySink.offers > memorySink.blocks.size());
+	CHECK(_wifiSerial.overruns() == 0);
+
+	// storage busy longer than ESP8266_SINK_TIMEOUT, body is closed incomplete without
+	// last block
+	memorySink.finalMs = ESP8266_SINK_TIMEOUT + 500;
+	sinkGet("/big");
+	id = std::to_string(wifi.getLastRequestId());
+	uint32_t stored = 3000 - 3000 % ESP8266_SINK_BLOCK;
+	CHECK(sinkStored.size() == 2 && sinkStored.back() == std::to_string(HTTP_CODE_BROKEN) + " " + id + " "
+		+ std::to_string(stored));
+	CHECK(memorySink.data == producerBodyOf(stored));
+
+	sinkGet("/small");
+	CHECK(sinkResponses.size() == 1 && sinkResponses.back() == "200 small");
+	static const char * const log[] = { "open 3000", "close 1", "open 3000", "close 0" };
+	CHECK(memorySink.log == std::vector<std::string>(log, log + 4));
+}
+
+struct Scenario {
+	const char *name;
+	void (*run)();
+};
+
+static const Scenario scenarios[] = {
+	{ "json", json },
+	{ "pool", poolModules },
+	{ "breaker", breaker },
+	{ "cache", cache },
+	{ "batch", batch },
+	{ "transport", transport },
+	{ "keywords", keywords },
+	{ "baud", baud },
+	{ "queue", queueEnds },
+	{ "pipelining", pipelining },
+	{ "demux", demux },
+	{ "transparent", transparent },
+	{ "producer", producer },
+	{ "ring", ring },
+	{ "sink", sinkSpill },
+};
+
+int main(int argc, char *argv[]) {
+	int failed = 0;
+	for (size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++) {
+		boolean selected = argc < 2;
+		for (int a = 1; a < argc; a++) {
+			selected = selected || strcmp(argv[a], scenarios[i].name) == 0;
+		}
+		if (!selected) {
+			continue;
+		}
+		fflush(stdout);
+		// library and virtual clock are global, every scenario starts from scratch
+		pid_t pid = fork();
+		if (pid == 0) {
+			scenarios[i].run();
+			fflush(stdout);
+			_exit(failures > 0 ? 1 : 0);
+		}
+		int status;
+		waitpid(pid, &status, 0);
+		boolean ok = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+		printf("%-12s %s\n", scenarios[i].name, ok ? "ok" : "FAILED");
+		if (!ok) {
+			failed++;
+		}
+	}
+	return failed;
+}